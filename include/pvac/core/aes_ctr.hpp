@@ -0,0 +1,731 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+#include "config.hpp"
+
+#if defined(__AES__) && defined(__SSE2__)
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#define PVAC_USE_AESNI 1
+#else
+#define PVAC_USE_AESNI 0
+#endif
+
+namespace pvac {
+
+#if PVAC_USE_AESNI
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PVAC_HAVE_VAES 1
+#define PVAC_TARGET_VAES __attribute__((target("aes,avx512f,vaes")))
+#define PVAC_TARGET_VAES256 __attribute__((target("aes,avx2,vaes")))
+#else
+#define PVAC_HAVE_VAES 0
+#endif
+
+// keystream kernel, picked at runtime:
+// 1 = aes-ni x8, 2 = vaes/avx-512 x16, 3 = vaes/avx2 x16.
+// atomic: the first prf call on any worker may be the one to pick it
+inline std::atomic<int> g_aes_impl{0};
+
+inline bool aes_ctr_has_impl(int impl) {
+    if (impl == 1) return true;
+#if PVAC_HAVE_VAES
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("vaes")) return false;
+    if (impl == 2) return __builtin_cpu_supports("avx512f");
+    if (impl == 3) return __builtin_cpu_supports("avx2");
+#endif
+    return false;
+}
+
+inline int select_aes_ctr() {
+    int impl = 1;
+    if (aes_ctr_has_impl(3)) impl = 3;
+    if (aes_ctr_has_impl(2)) impl = 2;
+    g_aes_impl.store(impl, std::memory_order_relaxed);
+
+    if (g_dbg > 1) {
+        const char* nm[] = {"", "aes-ni x8", "vaes512", "vaes256"};
+        std::cout << "aes = " << nm[impl] << "\n";
+    }
+    return impl;
+}
+
+inline int aes_impl() {
+    int impl = g_aes_impl.load(std::memory_order_relaxed);
+    return impl ? impl : select_aes_ctr();
+}
+
+struct AesCtr256 {
+    __m128i rk[15];
+    __m128i ctr;
+    alignas(16) uint64_t buf[2] = {0, 0};
+    bool has_buf = false;
+
+    static inline __m128i key_expand(__m128i k, __m128i t) {
+        t = _mm_shuffle_epi32(t, 0xFF);
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        return _mm_xor_si128(k, t);
+    }
+
+    static inline __m128i key_expand2(__m128i k1, __m128i k2) {
+        __m128i t = _mm_aeskeygenassist_si128(k2, 0);
+        t = _mm_shuffle_epi32(t, 0xAA);
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        return _mm_xor_si128(k1, t);
+    }
+
+    void init(const uint8_t key[32], uint64_t nonce) {
+        __m128i k0 = _mm_loadu_si128((const __m128i*)key);
+        __m128i k1 = _mm_loadu_si128((const __m128i*)(key + 16));
+
+        rk[0] = k0;
+        rk[1] = k1;
+        rk[2] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x01)); k0 = rk[2];
+        rk[3] = key_expand2(k1, k0); k1 = rk[3];
+        rk[4] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x02)); k0 = rk[4];
+        rk[5] = key_expand2(k1, k0); k1 = rk[5];
+        rk[6] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x04)); k0 = rk[6];
+        rk[7] = key_expand2(k1, k0); k1 = rk[7];
+        rk[8] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x08)); k0 = rk[8];
+        rk[9] = key_expand2(k1, k0); k1 = rk[9];
+        rk[10] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x10)); k0 = rk[10];
+        rk[11] = key_expand2(k1, k0); k1 = rk[11];
+        rk[12] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x20)); k0 = rk[12];
+        rk[13] = key_expand2(k1, k0); k1 = rk[13];
+        rk[14] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x40));
+
+        ctr = _mm_set_epi64x(0, (long long)nonce);
+        has_buf = false;
+    }
+
+    inline __m128i encrypt_ctr() {
+        __m128i t = _mm_xor_si128(ctr, rk[0]);
+        t = _mm_aesenc_si128(t, rk[1]);
+        t = _mm_aesenc_si128(t, rk[2]);
+        t = _mm_aesenc_si128(t, rk[3]);
+        t = _mm_aesenc_si128(t, rk[4]);
+        t = _mm_aesenc_si128(t, rk[5]);
+        t = _mm_aesenc_si128(t, rk[6]);
+        t = _mm_aesenc_si128(t, rk[7]);
+        t = _mm_aesenc_si128(t, rk[8]);
+        t = _mm_aesenc_si128(t, rk[9]);
+        t = _mm_aesenc_si128(t, rk[10]);
+        t = _mm_aesenc_si128(t, rk[11]);
+        t = _mm_aesenc_si128(t, rk[12]);
+        t = _mm_aesenc_si128(t, rk[13]);
+        t = _mm_aesenclast_si128(t, rk[14]);
+        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, 1));
+        return t;
+    }
+
+    inline uint64_t next_u64() {
+        if (has_buf) {
+            has_buf = false;
+            return buf[1];
+        }
+        __m128i ct = encrypt_ctr();
+        _mm_store_si128((__m128i*)buf, ct);
+        has_buf = true;
+        return buf[0];
+    }
+
+    // 8 counters per step: the 14 rounds run on aesenc throughput, not latency
+    inline size_t fill_blocks_x8(uint64_t* out, size_t nb) {
+        const __m128i one = _mm_set_epi64x(0, 1);
+
+        __m128i k[15];
+        for (int r = 0; r < 15; ++r) k[r] = rk[r];
+        __m128i c = ctr;
+
+        size_t b = 0;
+        for (; b + 8 <= nb; b += 8) {
+            __m128i t[8];
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; ++j) {
+                t[j] = _mm_xor_si128(c, k[0]);
+                c = _mm_add_epi64(c, one);
+            }
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 8
+                for (int j = 0; j < 8; ++j) t[j] = _mm_aesenc_si128(t[j], k[r]);
+            }
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; ++j) {
+                _mm_storeu_si128((__m128i*)(out + 2 * (b + j)), _mm_aesenclast_si128(t[j], k[14]));
+            }
+        }
+
+        ctr = c;
+        return b;
+    }
+
+#if PVAC_HAVE_VAES
+
+    // vaes: 4 counters per zmm, 4 zmm in flight
+    PVAC_TARGET_VAES inline size_t fill_blocks_vaes(uint64_t* out, size_t nb) {
+        __m512i k[15];
+        for (int r = 0; r < 15; ++r) k[r] = _mm512_maskz_broadcast_i32x4(0xFFFF, rk[r]);
+
+        const __m512i inc4 = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+        __m512i c = _mm512_add_epi64(_mm512_maskz_broadcast_i32x4(0xFFFF, ctr), _mm512_set_epi64(0, 3, 0, 2, 0, 1, 0, 0));
+
+        size_t b = 0;
+        for (; b + 16 <= nb; b += 16) {
+            __m512i t[4];
+#pragma GCC unroll 4
+            for (int j = 0; j < 4; ++j) {
+                t[j] = _mm512_xor_si512(c, k[0]);
+                c = _mm512_add_epi64(c, inc4);
+            }
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 4
+                for (int j = 0; j < 4; ++j) t[j] = _mm512_aesenc_epi128(t[j], k[r]);
+            }
+#pragma GCC unroll 4
+            for (int j = 0; j < 4; ++j) {
+                _mm512_storeu_si512((void*)(out + 2 * (b + 4 * j)), _mm512_aesenclast_epi128(t[j], k[14]));
+            }
+        }
+
+        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, (long long)b));
+        return b;
+    }
+
+#endif
+
+    // nb whole blocks straight into the caller's buffer
+    inline void fill_blocks(uint64_t* out, size_t nb) {
+        const int impl = aes_impl();
+        (void)impl;
+
+        size_t b = 0;
+#if PVAC_HAVE_VAES
+        if (impl == 2) b = fill_blocks_vaes(out, nb);
+#endif
+        b += fill_blocks_x8(out + 2 * b, nb - b);
+
+        for (; b < nb; ++b) {
+            _mm_storeu_si128((__m128i*)(out + 2 * b), encrypt_ctr());
+        }
+    }
+
+    inline void fill_u64(uint64_t* out, size_t n) {
+        size_t i = 0;
+        if (has_buf && n > 0) {
+            out[0] = buf[1];
+            has_buf = false;
+            i = 1;
+        }
+        size_t nb = (n - i) / 2;
+        fill_blocks(out + i, nb);
+        i += 2 * nb;
+        if (i < n) {
+            __m128i ct = encrypt_ctr();
+            _mm_store_si128((__m128i*)buf, ct);
+            out[i] = buf[0];
+            has_buf = true;
+        }
+    }
+
+    // and-xor of the next nb blocks against s, keystream stays in registers
+    inline size_t and_xor_x8(const uint64_t* s, size_t nb, __m128i& acc) {
+        const __m128i one = _mm_set_epi64x(0, 1);
+
+        __m128i k[15];
+        for (int r = 0; r < 15; ++r) k[r] = rk[r];
+        __m128i c = ctr;
+        __m128i a = acc;
+
+        size_t b = 0;
+        for (; b + 8 <= nb; b += 8) {
+            __m128i t[8];
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; ++j) {
+                t[j] = _mm_xor_si128(c, k[0]);
+                c = _mm_add_epi64(c, one);
+            }
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 8
+                for (int j = 0; j < 8; ++j) t[j] = _mm_aesenc_si128(t[j], k[r]);
+            }
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; ++j) {
+                __m128i w = _mm_aesenclast_si128(t[j], k[14]);
+                a = _mm_xor_si128(a, _mm_and_si128(w, _mm_loadu_si128((const __m128i*)(s + 2 * (b + j)))));
+            }
+        }
+
+        ctr = c;
+        acc = a;
+        return b;
+    }
+
+#if PVAC_HAVE_VAES
+
+    PVAC_TARGET_VAES inline size_t and_xor_vaes(const uint64_t* s, size_t nb, __m128i& acc) {
+        __m512i k[15];
+        for (int r = 0; r < 15; ++r) k[r] = _mm512_maskz_broadcast_i32x4(0xFFFF, rk[r]);
+
+        const __m512i inc4 = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+        __m512i c = _mm512_add_epi64(_mm512_maskz_broadcast_i32x4(0xFFFF, ctr), _mm512_set_epi64(0, 3, 0, 2, 0, 1, 0, 0));
+        __m512i a = _mm512_setzero_si512();
+
+        size_t b = 0;
+        for (; b + 16 <= nb; b += 16) {
+            __m512i t[4];
+#pragma GCC unroll 4
+            for (int j = 0; j < 4; ++j) {
+                t[j] = _mm512_xor_si512(c, k[0]);
+                c = _mm512_add_epi64(c, inc4);
+            }
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 4
+                for (int j = 0; j < 4; ++j) t[j] = _mm512_aesenc_epi128(t[j], k[r]);
+            }
+#pragma GCC unroll 4
+            for (int j = 0; j < 4; ++j) {
+                __m512i w = _mm512_aesenclast_epi128(t[j], k[14]);
+                a = _mm512_ternarylogic_epi64(a, w, _mm512_loadu_si512((const void*)(s + 2 * (b + 4 * j))), 0x78);
+            }
+        }
+
+        __m128i r = _mm_xor_si128(_mm512_maskz_extracti32x4_epi32(0xF, a, 0), _mm512_maskz_extracti32x4_epi32(0xF, a, 1));
+        r = _mm_xor_si128(r, _mm512_maskz_extracti32x4_epi32(0xF, a, 2));
+        r = _mm_xor_si128(r, _mm512_maskz_extracti32x4_epi32(0xF, a, 3));
+        acc = _mm_xor_si128(acc, r);
+
+        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, (long long)b));
+        return b;
+    }
+
+    // same on ymm for vaes parts without avx-512
+    PVAC_TARGET_VAES256 inline size_t and_xor_vaes256(const uint64_t* s, size_t nb, __m128i& acc) {
+        __m256i k[15];
+        for (int r = 0; r < 15; ++r) k[r] = _mm256_broadcastsi128_si256(rk[r]);
+
+        const __m256i inc2 = _mm256_set_epi64x(0, 2, 0, 2);
+        __m256i c = _mm256_add_epi64(_mm256_broadcastsi128_si256(ctr), _mm256_set_epi64x(0, 1, 0, 0));
+        __m256i a = _mm256_setzero_si256();
+
+        size_t b = 0;
+        for (; b + 16 <= nb; b += 16) {
+            __m256i t[8];
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; ++j) {
+                t[j] = _mm256_xor_si256(c, k[0]);
+                c = _mm256_add_epi64(c, inc2);
+            }
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 8
+                for (int j = 0; j < 8; ++j) t[j] = _mm256_aesenc_epi128(t[j], k[r]);
+            }
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; ++j) {
+                __m256i w = _mm256_aesenclast_epi128(t[j], k[14]);
+                a = _mm256_xor_si256(a, _mm256_and_si256(w, _mm256_loadu_si256((const __m256i*)(s + 2 * (b + 2 * j)))));
+            }
+        }
+
+        acc = _mm_xor_si128(acc, _mm_xor_si128(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1)));
+
+        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, (long long)b));
+        return b;
+    }
+
+#endif
+
+    // xor over i < n of (w[i] & s[i]) for the next n keystream words, the
+    // same value the fill_u64 + and loop gives but w never hits memory;
+    // a row that starts on the buffered high half reads s one word shifted
+    inline uint64_t and_xor_u64(const uint64_t* s, size_t n) {
+        const int impl = aes_impl();
+        (void)impl;
+
+        uint64_t x = 0;
+        if (has_buf && n > 0) {
+            x = buf[1] & s[0];
+            has_buf = false;
+            ++s;
+            --n;
+        }
+
+        size_t nb = n / 2;
+        __m128i acc = _mm_setzero_si128();
+        size_t b = 0;
+#if PVAC_HAVE_VAES
+        if (impl == 2) b = and_xor_vaes(s, nb, acc);
+        if (impl == 3) b = and_xor_vaes256(s, nb, acc);
+#endif
+        b += and_xor_x8(s + 2 * b, nb - b, acc);
+
+        for (; b < nb; ++b) {
+            acc = _mm_xor_si128(acc, _mm_and_si128(encrypt_ctr(), _mm_loadu_si128((const __m128i*)(s + 2 * b))));
+        }
+
+        alignas(16) uint64_t t[2];
+        _mm_store_si128((__m128i*)t, acc);
+        x ^= t[0] ^ t[1];
+
+        if (n & 1) {
+            __m128i ct = encrypt_ctr();
+            _mm_store_si128((__m128i*)buf, ct);
+            x ^= buf[0] & s[n - 1];
+            has_buf = true;
+        }
+        return x;
+    }
+
+    inline uint64_t bounded(uint64_t M) {
+        if (M <= 1) return 0;
+        uint64_t lim = UINT64_MAX - (UINT64_MAX % M);
+        for (;;) {
+            uint64_t x = next_u64();
+            if (x < lim) return x % M;
+        }
+    }
+
+    // one block from each of N independent streams per step, so the
+    // aesenc chains of different keys overlap; streams must be block aligned
+    template <size_t N>
+    static inline void fill_lanes_n(AesCtr256* const* p, uint64_t* const* out, size_t nblocks) {
+        const __m128i one = _mm_set_epi64x(0, 1);
+
+        __m128i k[15][N];
+        __m128i c[N];
+        for (size_t l = 0; l < N; ++l) {
+            for (int r = 0; r < 15; ++r) k[r][l] = p[l]->rk[r];
+            c[l] = p[l]->ctr;
+        }
+
+        for (size_t b = 0; b < nblocks; ++b) {
+            __m128i t[N];
+#pragma GCC unroll 8
+            for (size_t l = 0; l < N; ++l) t[l] = _mm_xor_si128(c[l], k[0][l]);
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 8
+                for (size_t l = 0; l < N; ++l) t[l] = _mm_aesenc_si128(t[l], k[r][l]);
+            }
+#pragma GCC unroll 8
+            for (size_t l = 0; l < N; ++l) {
+                t[l] = _mm_aesenclast_si128(t[l], k[14][l]);
+                _mm_storeu_si128((__m128i*)(out[l] + 2 * b), t[l]);
+                c[l] = _mm_add_epi64(c[l], one);
+            }
+        }
+
+        for (size_t l = 0; l < N; ++l) p[l]->ctr = c[l];
+    }
+
+#if PVAC_HAVE_VAES
+
+    PVAC_TARGET_VAES static inline __m512i pack4(const __m128i* q) {
+        __m512i z = _mm512_castsi128_si512(q[0]);
+        z = _mm512_inserti32x4(z, q[1], 1);
+        z = _mm512_inserti32x4(z, q[2], 2);
+        return _mm512_inserti32x4(z, q[3], 3);
+    }
+
+    PVAC_TARGET_VAES static inline void unpack4(__m512i z, __m128i* q) {
+        q[0] = _mm512_maskz_extracti32x4_epi32(0xF, z, 0);
+        q[1] = _mm512_maskz_extracti32x4_epi32(0xF, z, 1);
+        q[2] = _mm512_maskz_extracti32x4_epi32(0xF, z, 2);
+        q[3] = _mm512_maskz_extracti32x4_epi32(0xF, z, 3);
+    }
+
+    template <size_t NG, size_t U>
+    PVAC_TARGET_VAES static inline void lanes_vaes_step(
+        const __m512i (*k)[NG], __m512i* c, uint64_t* const* out, size_t n, size_t b
+    ) {
+        const __m512i inc1 = _mm512_set_epi64(0, 1, 0, 1, 0, 1, 0, 1);
+        __m512i t[NG][U];
+
+#pragma GCC unroll 8
+        for (size_t g = 0; g < NG; ++g) {
+#pragma GCC unroll 8
+            for (size_t u = 0; u < U; ++u) {
+                t[g][u] = _mm512_xor_si512(c[g], k[0][g]);
+                c[g] = _mm512_add_epi64(c[g], inc1);
+            }
+        }
+#pragma GCC unroll 13
+        for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 8
+            for (size_t g = 0; g < NG; ++g) {
+#pragma GCC unroll 8
+                for (size_t u = 0; u < U; ++u) t[g][u] = _mm512_aesenc_epi128(t[g][u], k[r][g]);
+            }
+        }
+#pragma GCC unroll 8
+        for (size_t g = 0; g < NG; ++g) {
+#pragma GCC unroll 8
+            for (size_t u = 0; u < U; ++u) {
+                __m128i q[4];
+                unpack4(_mm512_aesenclast_epi128(t[g][u], k[14][g]), q);
+                for (size_t j = 0; j < 4 && 4 * g + j < n; ++j) {
+                    _mm_storeu_si128((__m128i*)(out[4 * g + j] + 2 * (b + u)), q[j]);
+                }
+            }
+        }
+    }
+
+    // vaes: four lanes per zmm, every 128-bit slot runs its own key schedule,
+    // U consecutive blocks per lane keep NG * U chains in flight
+    template <size_t NG, size_t U>
+    PVAC_TARGET_VAES static inline void fill_lanes_vaes(AesCtr256* const* p, uint64_t* const* out, size_t n, size_t nblocks) {
+        __m512i k[15][NG];
+        __m512i c[NG];
+
+        for (size_t g = 0; g < NG; ++g) {
+            __m128i q[4];
+            for (int r = 0; r < 15; ++r) {
+                for (size_t j = 0; j < 4; ++j) q[j] = p[std::min(4 * g + j, n - 1)]->rk[r];
+                k[r][g] = pack4(q);
+            }
+            for (size_t j = 0; j < 4; ++j) q[j] = p[std::min(4 * g + j, n - 1)]->ctr;
+            c[g] = pack4(q);
+        }
+
+        size_t b = 0;
+        for (; b + U <= nblocks; b += U) lanes_vaes_step<NG, U>(k, c, out, n, b);
+        for (; b < nblocks; ++b) lanes_vaes_step<NG, 1>(k, c, out, n, b);
+
+        for (size_t g = 0; g < NG; ++g) {
+            __m128i q[4];
+            unpack4(c[g], q);
+            for (size_t j = 0; j < 4 && 4 * g + j < n; ++j) p[4 * g + j]->ctr = q[j];
+        }
+    }
+
+#endif
+
+    static inline void fill_lanes(AesCtr256* const* p, uint64_t* const* out, size_t n, size_t nblocks) {
+        const int impl = aes_impl();
+        (void)impl;
+
+#if PVAC_HAVE_VAES
+        if (impl == 2 && n > 4) { fill_lanes_vaes<2, 2>(p, out, n, nblocks); return; }
+        if (impl == 2 && n > 1) { fill_lanes_vaes<1, 4>(p, out, n, nblocks); return; }
+#endif
+        switch (n) {
+            case 0: return;
+            case 1: p[0]->fill_blocks(out[0], nblocks); return;
+            case 2: fill_lanes_n<2>(p, out, nblocks); return;
+            case 3: fill_lanes_n<3>(p, out, nblocks); return;
+            case 4: fill_lanes_n<4>(p, out, nblocks); return;
+            case 5: fill_lanes_n<5>(p, out, nblocks); return;
+            case 6: fill_lanes_n<6>(p, out, nblocks); return;
+            case 7: fill_lanes_n<7>(p, out, nblocks); return;
+            default: fill_lanes_n<8>(p, out, nblocks); return;
+        }
+    }
+};
+
+// up to 8 streams that run rows against one shared s in step, as the lpn
+// row engine does: and_xor_u64 on every stream, interleaved, with a block
+// of s loaded once for all lanes. the key schedules are packed four lanes
+// per zmm once, at init, instead of on every row
+struct AesCtrLanes {
+    static constexpr size_t MAX = 8;
+
+    AesCtr256* p[MAX] = {};
+    size_t n = 0;
+    alignas(64) uint64_t kv[15][2][8];
+
+    void init(AesCtr256* const* q, size_t nl) {
+        n = std::min(nl, MAX);
+        for (size_t l = 0; l < n; ++l) p[l] = q[l];
+        if (!n) return;
+
+        // slots past n repeat the last lane, their output is dropped
+        for (int r = 0; r < 15; ++r) {
+            for (size_t j = 0; j < 8; ++j) {
+                _mm_storeu_si128((__m128i*)&kv[r][j / 4][2 * (j % 4)], p[std::min(j, n - 1)]->rk[r]);
+            }
+        }
+    }
+
+    // blocks of N streams against s, keys straight from each stream
+    template <size_t N>
+    inline void and_xor_n(const uint64_t* s, size_t nb, __m128i* acc) {
+        const __m128i one = _mm_set_epi64x(0, 1);
+
+        __m128i c[N];
+        __m128i a[N];
+        for (size_t l = 0; l < N; ++l) {
+            c[l] = p[l]->ctr;
+            a[l] = acc[l];
+        }
+
+        for (size_t b = 0; b < nb; ++b) {
+            const __m128i sb = _mm_loadu_si128((const __m128i*)(s + 2 * b));
+            __m128i t[N];
+#pragma GCC unroll 8
+            for (size_t l = 0; l < N; ++l) t[l] = _mm_xor_si128(c[l], p[l]->rk[0]);
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 8
+                for (size_t l = 0; l < N; ++l) t[l] = _mm_aesenc_si128(t[l], p[l]->rk[r]);
+            }
+#pragma GCC unroll 8
+            for (size_t l = 0; l < N; ++l) {
+                a[l] = _mm_xor_si128(a[l], _mm_and_si128(_mm_aesenclast_si128(t[l], p[l]->rk[14]), sb));
+                c[l] = _mm_add_epi64(c[l], one);
+            }
+        }
+
+        for (size_t l = 0; l < N; ++l) {
+            p[l]->ctr = c[l];
+            acc[l] = a[l];
+        }
+    }
+
+#if PVAC_HAVE_VAES
+
+    // four lanes per zmm as in fill_lanes_vaes, the block of s broadcast to
+    // all four slots and folded in with one ternarylogic
+    template <size_t NG, size_t U>
+    PVAC_TARGET_VAES inline size_t and_xor_vaes(const uint64_t* s, size_t nb, __m128i* acc) {
+        const __m512i inc1 = _mm512_set_epi64(0, 1, 0, 1, 0, 1, 0, 1);
+        alignas(64) uint64_t q[2][8];
+
+        for (size_t j = 0; j < 8; ++j) {
+            _mm_storeu_si128((__m128i*)&q[j / 4][2 * (j % 4)], p[std::min(j, n - 1)]->ctr);
+        }
+
+        __m512i c[NG];
+        __m512i a[NG];
+        for (size_t g = 0; g < NG; ++g) {
+            c[g] = _mm512_load_si512((const void*)q[g]);
+            a[g] = _mm512_setzero_si512();
+        }
+
+        size_t b = 0;
+        for (; b + U <= nb; b += U) {
+            __m512i t[NG][U];
+
+#pragma GCC unroll 8
+            for (size_t g = 0; g < NG; ++g) {
+                const __m512i k0 = _mm512_load_si512((const void*)kv[0][g]);
+#pragma GCC unroll 8
+                for (size_t u = 0; u < U; ++u) {
+                    t[g][u] = _mm512_xor_si512(c[g], k0);
+                    c[g] = _mm512_add_epi64(c[g], inc1);
+                }
+            }
+#pragma GCC unroll 13
+            for (int r = 1; r < 14; ++r) {
+#pragma GCC unroll 8
+                for (size_t g = 0; g < NG; ++g) {
+                    const __m512i kr = _mm512_load_si512((const void*)kv[r][g]);
+#pragma GCC unroll 8
+                    for (size_t u = 0; u < U; ++u) t[g][u] = _mm512_aesenc_epi128(t[g][u], kr);
+                }
+            }
+#pragma GCC unroll 8
+            for (size_t u = 0; u < U; ++u) {
+                const __m512i sb = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128((const __m128i*)(s + 2 * (b + u))));
+#pragma GCC unroll 8
+                for (size_t g = 0; g < NG; ++g) {
+                    const __m512i kl = _mm512_load_si512((const void*)kv[14][g]);
+                    a[g] = _mm512_ternarylogic_epi64(a[g], _mm512_aesenclast_epi128(t[g][u], kl), sb, 0x78);
+                }
+            }
+        }
+
+        alignas(64) uint64_t z[2][8];
+        for (size_t g = 0; g < NG; ++g) {
+            _mm512_store_si512((void*)q[g], c[g]);
+            _mm512_store_si512((void*)z[g], a[g]);
+        }
+        for (size_t l = 0; l < n; ++l) {
+            p[l]->ctr = _mm_loadu_si128((const __m128i*)&q[l / 4][2 * (l % 4)]);
+            acc[l] = _mm_xor_si128(acc[l], _mm_loadu_si128((const __m128i*)&z[l / 4][2 * (l % 4)]));
+        }
+        return b;
+    }
+
+#endif
+
+    // x[l] = p[l]->and_xor_u64(s, nw) for every lane. lanes stay in step
+    // unless a rejection in bounded() moved one onto the other half of a
+    // block; then every lane goes on its own for that row
+    inline void and_xor(const uint64_t* s, size_t nw, uint64_t* x) {
+        bool split = false;
+        for (size_t l = 1; l < n; ++l) split |= p[l]->has_buf != p[0]->has_buf;
+
+        if (n < 2 || split || nw == 0) {
+            for (size_t l = 0; l < n; ++l) x[l] = p[l]->and_xor_u64(s, nw);
+            return;
+        }
+
+        const int impl = aes_impl();
+        (void)impl;
+
+        uint64_t x0[MAX];
+        const bool odd = p[0]->has_buf;
+        for (size_t l = 0; l < n; ++l) {
+            x0[l] = 0;
+            if (odd) {
+                x0[l] = p[l]->buf[1] & s[0];
+                p[l]->has_buf = false;
+            }
+        }
+        if (odd) {
+            ++s;
+            --nw;
+        }
+
+        const size_t nb = nw / 2;
+        __m128i acc[MAX];
+        for (size_t l = 0; l < n; ++l) acc[l] = _mm_setzero_si128();
+
+        size_t b = 0;
+#if PVAC_HAVE_VAES
+        if (impl == 2) b = n > 4 ? and_xor_vaes<2, 2>(s, nb, acc) : and_xor_vaes<1, 4>(s, nb, acc);
+#endif
+        switch (n) {
+            case 2: and_xor_n<2>(s + 2 * b, nb - b, acc); break;
+            case 3: and_xor_n<3>(s + 2 * b, nb - b, acc); break;
+            case 4: and_xor_n<4>(s + 2 * b, nb - b, acc); break;
+            case 5: and_xor_n<5>(s + 2 * b, nb - b, acc); break;
+            case 6: and_xor_n<6>(s + 2 * b, nb - b, acc); break;
+            case 7: and_xor_n<7>(s + 2 * b, nb - b, acc); break;
+            default: and_xor_n<8>(s + 2 * b, nb - b, acc); break;
+        }
+
+        for (size_t l = 0; l < n; ++l) {
+            AesCtr256& q = *p[l];
+            alignas(16) uint64_t t[2];
+            _mm_store_si128((__m128i*)t, acc[l]);
+            x[l] = x0[l] ^ t[0] ^ t[1];
+
+            if (nw & 1) {
+                _mm_store_si128((__m128i*)q.buf, q.encrypt_ctr());
+                x[l] ^= q.buf[0] & s[nw - 1];
+                q.has_buf = true;
+            }
+        }
+    }
+};
+
+#endif
+
+}
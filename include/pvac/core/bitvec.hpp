@@ -1,13 +1,91 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
 #include <vector>
 #include <algorithm>
 
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
 namespace pvac {
 
+// m_bits of the shipped parameter sets, sigmas of this size take the
+// fixed width kernels below
+inline constexpr size_t SIGMA_BITS = 8192;
+inline constexpr size_t SIGMA_W = SIGMA_BITS / 64;
+
+// xor and popcount over W words, W known at compile time so the loops
+// unroll into full vectors. loads are unaligned, any word array works
+namespace bvk {
+
+template <size_t W>
+inline void xor_words(uint64_t * a, const uint64_t * b) {
+#if defined(__AVX512F__)
+    if constexpr (W % 8 == 0) {
+        for (size_t i = 0; i < W; i += 8) {
+            __m512i x = _mm512_loadu_si512((const void *)(a + i));
+            __m512i y = _mm512_loadu_si512((const void *)(b + i));
+            _mm512_storeu_si512((void *)(a + i), _mm512_xor_si512(x, y));
+        }
+        return;
+    }
+#elif defined(__AVX2__)
+    if constexpr (W % 4 == 0) {
+        for (size_t i = 0; i < W; i += 4) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+            __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+            _mm256_storeu_si256((__m256i *)(a + i), _mm256_xor_si256(x, y));
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < W; i++) a[i] ^= b[i];
+}
+
+template <size_t W>
+inline size_t popcnt_words(const uint64_t * a) {
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    if constexpr (W % 8 == 0) {
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t i = 0; i < W; i += 8) {
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512((const void *)(a + i))));
+        }
+        alignas(64) uint64_t t[8];
+        _mm512_store_si512((void *)t, acc);
+        return (size_t)(t[0] + t[1] + t[2] + t[3] + t[4] + t[5] + t[6] + t[7]);
+    }
+#elif defined(__AVX2__)
+    // nibble table lookup, byte counts summed by sad
+    if constexpr (W % 4 == 0) {
+        const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low = _mm256_set1_epi8(0x0f);
+        __m256i acc = _mm256_setzero_si256();
+
+        for (size_t i = 0; i < W; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(a + i));
+            __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+            __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+        }
+
+        return (size_t)(_mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+                        _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3));
+    }
+#endif
+    size_t s = 0;
+    for (size_t i = 0; i < W; i++) s += (size_t)__builtin_popcountll(a[i]);
+    return s;
+}
+
+}
+
 struct BitVec {
-    size_t nbits;
+    size_t nbits = 0;
     std::vector<uint64_t> w;
 
     static BitVec make(size_t n) {
@@ -18,6 +96,11 @@ struct BitVec {
     }
 
     void xor_with(const BitVec & b) {
+        if (w.size() == SIGMA_W && b.w.size() == SIGMA_W) {
+            bvk::xor_words<SIGMA_W>(w.data(), b.w.data());
+            return;
+        }
+
         size_t L = std::min(w.size(), b.w.size());
         for (size_t i = 0; i < L; i++) {
             w[i] ^= b.w[i];
@@ -25,6 +108,10 @@ struct BitVec {
     }
 
     size_t popcnt() const {
+        if (w.size() == SIGMA_W) {
+            return bvk::popcnt_words<SIGMA_W>(w.data());
+        }
+
         auto pc = [](uint64_t x) {
             return (uint32_t)__builtin_popcountll(x);
         };
@@ -45,4 +132,68 @@ struct BitVec {
         x &= 0xF;
         return (0x6996 >> x) & 1;
     }
-}
\ No newline at end of file
+// NBITS bits inline, 64 byte aligned, for scratch rows of a known width
+template <size_t NBITS>
+struct FixedBitVec {
+    static_assert(NBITS % 512 == 0, "whole cache lines");
+    static constexpr size_t W = NBITS / 64;
+
+    alignas(64) uint64_t w[W] = {};
+
+    void clear() {
+        std::memset(w, 0, sizeof(w));
+    }
+
+    void xor_with(const FixedBitVec & b) {
+        bvk::xor_words<W>(w, b.w);
+    }
+
+    void xor_with(const uint64_t * b) {
+        bvk::xor_words<W>(w, b);
+    }
+
+    size_t popcnt() const {
+        return bvk::popcnt_words<W>(w);
+    }
+
+    BitVec to_bitvec() const {
+        BitVec v;
+        v.nbits = NBITS;
+        v.w.assign(w, w + W);
+        return v;
+    }
+};
+
+using SigmaBits = FixedBitVec<SIGMA_BITS>;
+
+// std allocator with A byte aligned blocks, for slabs scanned by simd
+template <class T, size_t A = 64>
+struct AlignedAlloc {
+    using value_type = T;
+
+    template <class U>
+    struct rebind { using other = AlignedAlloc<U, A>; };
+
+    AlignedAlloc() = default;
+
+    template <class U>
+    AlignedAlloc(const AlignedAlloc<U, A> &) {}
+
+    T * allocate(size_t n) {
+        return (T *)::operator new(n * sizeof(T), std::align_val_t(A));
+    }
+
+    void deallocate(T * p, size_t) {
+        ::operator delete(p, std::align_val_t(A));
+    }
+
+    template <class U>
+    bool operator==(const AlignedAlloc<U, A> &) const { return true; }
+
+    template <class U>
+    bool operator!=(const AlignedAlloc<U, A> &) const { return false; }
+};
+
+using SigmaSlab = std::vector<uint64_t, AlignedAlloc<uint64_t>>;
+
+}
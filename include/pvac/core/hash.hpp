@@ -4,12 +4,17 @@
 #include <cstring>
 #include <string>
 #include <vector>
+#include <array>
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
 
 #include "random.hpp"
 
+#if defined(__SSE4_2__)
+    #include <nmmintrin.h>
+#endif
+
 namespace pvac {
 
 inline std::string hex8(const uint8_t* d, size_t n) {
@@ -190,6 +195,42 @@ inline void sha256_acc_u64(Sha256& s, uint64_t x) {
     s.update(b, 8);
 }
 
+// crc32c (castagnoli), the sse4.2 instruction when built for it. a
+// record checksum, not a mac
+inline uint32_t crc32c(const uint8_t* p, size_t n, uint32_t crc = 0) {
+    crc = ~crc;
+
+#if defined(__SSE4_2__)
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t x;
+        std::memcpy(&x, p, 8);
+        crc = (uint32_t)_mm_crc32_u64(crc, x);
+    }
+
+    for (; n; p++, n--) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+#else
+    static const auto T = []() {
+        std::array<uint32_t, 256> t {};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1)));
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    for (; n; p++, n--) {
+        crc = T[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+#endif
+
+    return ~crc;
+}
+
 struct Shake256 {
     uint64_t st[25];
     size_t rate;
@@ -211,55 +252,57 @@ struct Shake256 {
         0x0000000080000001ULL, 0x8000000080008008ULL
     };
 
-    static constexpr int ROT[5][5] = {
-        {  0, 36,  3, 41, 18 },
-        {  1, 44, 10, 45,  2 },
-        { 62,  6, 43, 15, 61 },
-        { 28, 55, 25, 21, 56 },
-        { 27, 20, 39,  8, 14 }
+    // flat lane tables: lane i = x + 5y moves to PI[i] rotated by RHO[i]
+    static constexpr int PI[25] = {
+         0, 10, 20,  5, 15,
+        16,  1, 11, 21,  6,
+         7, 17,  2, 12, 22,
+        23,  8, 18,  3, 13,
+        14, 24,  9, 19,  4
+    };
+
+    static constexpr int RHO[25] = {
+         0,  1, 62, 28, 27,
+        36, 44,  6, 55, 20,
+         3, 10, 43, 25, 39,
+        41, 45, 15, 21,  8,
+        18,  2, 61, 56, 14
     };
 
     static uint64_t rotl(uint64_t x, int r) {
-        return (x << r) | (x >> (64 - r));
+        return r ? (x << r) | (x >> (64 - r)) : x;
     }
 
-    void keccakf() {
+    static void permute(uint64_t* A) {
         for (int round = 0; round < 24; ++round) {
-            uint64_t C[5];
-            for (int x = 0; x < 5; x++) {
-                C[x] = st[x] ^ st[x + 5] ^ st[x + 10] ^ st[x + 15] ^ st[x + 20];
-            }
+            uint64_t C[5], D[5], B[25];
 
-            uint64_t D[5];
+#pragma GCC unroll 5
             for (int x = 0; x < 5; x++) {
-                D[x] = C[(x + 4) % 5] ^ rotl(C[(x + 1) % 5], 1);
+                C[x] = A[x] ^ A[x + 5] ^ A[x + 10] ^ A[x + 15] ^ A[x + 20];
             }
-
+#pragma GCC unroll 5
             for (int x = 0; x < 5; x++) {
-                for (int y = 0; y < 5; y++) {
-                    st[x + 5 * y] ^= D[x];
-                }
+                D[x] = C[(x + 4) % 5] ^ rotl(C[(x + 1) % 5], 1);
             }
-
-            uint64_t B[25];
-            for (int x = 0; x < 5; x++) {
-                for (int y = 0; y < 5; y++) {
-                    int X = y;
-                    int Y = (2 * x + 3 * y) % 5;
-                    B[X + 5 * Y] = rotl(st[x + 5 * y], ROT[x][y]);
-                }
+#pragma GCC unroll 25
+            for (int i = 0; i < 25; i++) {
+                B[PI[i]] = rotl(A[i] ^ D[i % 5], RHO[i]);
             }
-
-            for (int x = 0; x < 5; x++) {
-                for (int y = 0; y < 5; y++) {
-                    st[x + 5 * y] = B[x + 5 * y] ^ ((~B[(x + 1) % 5 + 5 * y]) & B[(x + 2) % 5 + 5 * y]);
-                }
+#pragma GCC unroll 25
+            for (int i = 0; i < 25; i++) {
+                int r = i - i % 5;
+                A[i] = B[i] ^ (~B[r + (i + 1) % 5] & B[r + (i + 2) % 5]);
             }
 
-            st[0] ^= RC[round];
+            A[0] ^= RC[round];
         }
     }
 
+    void keccakf() {
+        permute(st);
+    }
+
     void init() {
         std::fill(std::begin(st), std::end(st), 0);
         rate = 136;
@@ -347,6 +390,42 @@ struct Shake256 {
     }
 };
 
+// four independent keccak-f[1600] states, lane i of state l at A[i][l],
+// stepped together so every lane op is one 256-bit vector op
+struct Keccak4 {
+    typedef uint64_t v4 __attribute__((vector_size(32)));
+
+    static v4 rotl(v4 x, int r) {
+        return r ? (x << r) | (x >> (64 - r)) : x;
+    }
+
+    static void permute(v4* A) {
+        for (int round = 0; round < 24; ++round) {
+            v4 C[5], D[5], B[25];
+
+#pragma GCC unroll 5
+            for (int x = 0; x < 5; x++) {
+                C[x] = A[x] ^ A[x + 5] ^ A[x + 10] ^ A[x + 15] ^ A[x + 20];
+            }
+#pragma GCC unroll 5
+            for (int x = 0; x < 5; x++) {
+                D[x] = C[(x + 4) % 5] ^ rotl(C[(x + 1) % 5], 1);
+            }
+#pragma GCC unroll 25
+            for (int i = 0; i < 25; i++) {
+                B[Shake256::PI[i]] = rotl(A[i] ^ D[i % 5], Shake256::RHO[i]);
+            }
+#pragma GCC unroll 25
+            for (int i = 0; i < 25; i++) {
+                int r = i - i % 5;
+                A[i] = B[i] ^ (~B[r + (i + 1) % 5] & B[r + (i + 2) % 5]);
+            }
+
+            A[0] ^= Shake256::RC[round];
+        }
+    }
+};
+
 struct XofShake {
     Shake256 sh;
 
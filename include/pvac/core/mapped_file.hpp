@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cerrno>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #define PVAC_HAVE_MMAP 1
+#else
+    #define PVAC_HAVE_MMAP 0
+#endif
+
+namespace pvac {
+
+// read-only view of a whole file, mmap where available, a heap copy otherwise
+struct MappedFile {
+    const uint8_t * data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const std::string & path) {
+        close();
+
+#if PVAC_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void * p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (p == MAP_FAILED) {
+            return false;
+        }
+
+        madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+        data = (const uint8_t *)p;
+        size = (size_t)st.st_size;
+        return true;
+#else
+        std::ifstream f(path, std::ios::binary);
+
+        if (!f) {
+            return false;
+        }
+
+        heap.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+
+        if (heap.empty()) {
+            return false;
+        }
+
+        data = heap.data();
+        size = heap.size();
+        return true;
+#endif
+    }
+
+    void close() {
+#if PVAC_HAVE_MMAP
+        if (data) {
+            munmap((void *)data, size);
+        }
+#else
+        heap.clear();
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+#if !PVAC_HAVE_MMAP
+    std::vector<uint8_t> heap;
+#endif
+};
+
+// write aside and rename so readers never see a half written file. the
+// temp name is unique per writer, so concurrent saves of the same path
+// cannot publish each other's partial output; it is removed on failure
+inline bool write_file_atomic(const std::string & path, const void * data, size_t n) {
+#if PVAC_HAVE_MMAP
+    std::string tmp = path + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    // mkstemp makes it 0600, the plain ofstream path gave 0644
+    bool ok = fchmod(fd, 0644) == 0;
+    const uint8_t * p = (const uint8_t *)data;
+
+    while (ok && n > 0) {
+        ssize_t w = ::write(fd, p, n);
+
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (w <= 0) {
+            ok = false;
+            break;
+        }
+
+        p += w;
+        n -= (size_t)w;
+    }
+
+    ok = (::close(fd) == 0) && ok;
+#else
+    std::string tmp = path + ".tmp" + std::to_string(std::random_device{}());
+    bool ok;
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write((const char *)data, (std::streamsize)n);
+        ok = (bool)f;
+    }
+#endif
+
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+}
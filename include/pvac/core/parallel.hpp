@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pvac {
+
+// worker count for the parallel kernels, PVAC_THREADS=1 runs serial
+inline int g_threads = []() {
+    const char * s = std::getenv("PVAC_THREADS");
+    int n = s ? std::atoi(s) : (int)std::thread::hardware_concurrency();
+    return std::max(1, n);
+}();
+
+inline void set_threads(int n) {
+    g_threads = std::max(1, n);
+}
+
+inline int get_threads() {
+    return g_threads;
+}
+
+// true on a thread that is running a parallel_for body
+inline thread_local bool t_in_parallel = false;
+
+// helper threads kept across parallel_for calls, so a worker's
+// thread_local scratch (prf rows, sigma buffers, ...) lives from one call
+// to the next instead of with a thread per call. one job at a time: a
+// parallel_for from another thread that finds it busy gets its own threads
+class WorkerPool {
+public:
+    static WorkerPool & get() {
+        static WorkerPool p;
+        return p;
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            stop = true;
+        }
+        cv.notify_all();
+
+        for (auto & t : th) {
+            t.join();
+        }
+    }
+
+    // work on k helpers and the caller, back once every helper that
+    // picked it up is done. false, without running anything, when busy
+    bool run(size_t k, const std::function<void()> & work) {
+        std::unique_lock<std::mutex> busy(run_mu, std::try_to_lock);
+
+        if (!busy) {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            while (th.size() < k) {
+                th.emplace_back([this]() { loop(); });
+            }
+            job = &work;
+            want = k;
+            gen++;
+        }
+        cv.notify_all();
+
+        work();
+
+        // helpers that have not woken yet have nothing left to take
+        std::unique_lock<std::mutex> lk(mu);
+        want = 0;
+        done.wait(lk, [&]() { return active == 0; });
+        job = nullptr;
+        return true;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lk(mu);
+        return th.size();
+    }
+
+private:
+    void loop() {
+        t_in_parallel = true;
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lk(mu);
+
+        for (;;) {
+            cv.wait(lk, [&]() { return stop || (gen != seen && want > 0); });
+
+            if (stop) {
+                return;
+            }
+
+            seen = gen;
+            want--;
+            active++;
+            const std::function<void()> * w = job;
+
+            lk.unlock();
+            (*w)();
+            lk.lock();
+
+            if (--active == 0) {
+                done.notify_all();
+            }
+        }
+    }
+
+    std::mutex run_mu;
+    std::mutex mu;
+    std::condition_variable cv, done;
+    std::vector<std::thread> th;
+    const std::function<void()> * job = nullptr;
+    size_t want = 0;
+    size_t active = 0;
+    uint64_t gen = 0;
+    bool stop = false;
+};
+
+// f(lo, hi) over [0, n) in chunks of grain, chunks handed out through
+// an atomic counter to the pool helpers, the caller thread works too. a
+// parallel_for inside another one runs inline, so nested kernels
+// (dec_value in an archive scan, ...) do not spawn threads on every worker
+template <class F>
+inline void parallel_for(size_t n, size_t grain, F && f) {
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (n + grain - 1) / grain;
+    size_t nt = std::min<size_t>((size_t)g_threads, chunks);
+
+    if (nt <= 1 || t_in_parallel) {
+        if (n) {
+            f((size_t)0, n);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+
+    auto work = [&]() {
+        for (;;) {
+            size_t c = next.fetch_add(1, std::memory_order_relaxed);
+
+            if (c >= chunks) {
+                return;
+            }
+
+            size_t lo = c * grain;
+            f(lo, std::min(n, lo + grain));
+        }
+    };
+
+    const std::function<void()> job = [&]() {
+        t_in_parallel = true;
+        work();
+    };
+
+    if (WorkerPool::get().run(nt - 1, job)) {
+        t_in_parallel = false;
+        return;
+    }
+
+    std::vector<std::thread> th;
+    th.reserve(nt - 1);
+
+    for (size_t i = 1; i < nt; i++) {
+        th.emplace_back(job);
+    }
+
+    job();
+    t_in_parallel = false;
+
+    for (auto & t : th) {
+        t.join();
+    }
+}
+
+// std::sort of [first, last): one slice per worker sorted in parallel,
+// then merged pairwise in rounds. small ranges sort serially
+template <class It, class Cmp = std::less<>>
+inline void parallel_sort(It first, It last, Cmp cmp = Cmp {}) {
+    const size_t n = (size_t)(last - first);
+    const size_t nt = std::min<size_t>((size_t)g_threads, n / 4096);
+
+    if (nt <= 1) {
+        std::sort(first, last, cmp);
+        return;
+    }
+
+    const size_t step = (n + nt - 1) / nt;
+
+    parallel_for(nt, 1, [&](size_t lo, size_t hi) {
+        for (size_t c = lo; c < hi; c++) {
+            std::sort(first + c * step, first + std::min(n, (c + 1) * step), cmp);
+        }
+    });
+
+    for (size_t w = step; w < n; w *= 2) {
+        parallel_for((n + 2 * w - 1) / (2 * w), 1, [&](size_t lo, size_t hi) {
+            for (size_t p = lo; p < hi; p++) {
+                size_t a = p * 2 * w;
+                size_t m = std::min(n, a + w);
+                size_t b = std::min(n, a + 2 * w);
+
+                if (m < b) {
+                    std::inplace_merge(first + a, first + m, first + b, cmp);
+                }
+            }
+        });
+    }
+}
+
+}
@@ -4,6 +4,13 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+
+#include "aes_ctr.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <pthread.h>
+#endif
 
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
     #include <stdlib.h>
@@ -103,10 +110,126 @@ inline void csprng_bytes(uint8_t * out, size_t n) {
 #endif
 }
 
+#if PVAC_USE_AESNI
+
+// per-thread aes-256-ctr drbg seeded from csprng_bytes. fast key erasure:
+// every refill derives the next key from the head of its own keystream
+// and output words are wiped as they are handed out. reseeds from the os
+// every CSPRNG_RESEED_BYTES and in a forked child (atfork generation)
+
+inline constexpr size_t CSPRNG_BUF_WORDS = 256;
+inline constexpr uint64_t CSPRNG_RESEED_BYTES = (uint64_t)1 << 20;
+
+inline std::atomic<uint64_t> g_csprng_fork_gen{0};
+
+// volatile stores, not elided like a dead memset
+inline void csprng_wipe(void * p, size_t n) {
+    volatile uint8_t * q = (volatile uint8_t *)p;
+    for (size_t i = 0; i < n; i++) q[i] = 0;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+inline const int g_csprng_atfork = []() {
+    return pthread_atfork(nullptr, nullptr, []() {
+        g_csprng_fork_gen.fetch_add(1, std::memory_order_relaxed);
+    });
+}();
+#endif
+
+struct CsprngDrbg {
+    uint8_t key[32];
+    uint64_t buf[CSPRNG_BUF_WORDS];
+    size_t left = 0;
+    uint64_t since_seed = 0;
+    uint64_t gen = 0;
+    bool seeded = false;
+
+    void reseed() {
+        csprng_bytes(key, 32);
+        left = 0;
+        since_seed = 0;
+        gen = g_csprng_fork_gen.load(std::memory_order_relaxed);
+        seeded = true;
+    }
+
+    void check() {
+        if (!seeded || since_seed >= CSPRNG_RESEED_BYTES ||
+            gen != g_csprng_fork_gen.load(std::memory_order_relaxed)) {
+            reseed();
+        }
+    }
+
+    // 4 words of new key, then n words of output
+    void run(uint64_t* out, size_t n) {
+        AesCtr256 prg;
+        prg.init(key, 0);
+
+        uint64_t nk[4];
+        prg.fill_u64(nk, 4);
+        prg.fill_u64(out, n);
+        for (int i = 0; i < 4; i++) store_le64(key + 8 * i, nk[i]);
+
+        csprng_wipe(nk, sizeof(nk));
+        csprng_wipe(&prg, sizeof(prg));
+        since_seed += 8 * (n + 4);
+    }
+
+    uint64_t next() {
+        check();
+        if (!left) {
+            run(buf, CSPRNG_BUF_WORDS);
+            left = CSPRNG_BUF_WORDS;
+        }
+        uint64_t x = buf[--left];
+        buf[left] = 0;
+        return x;
+    }
+
+    void fill(uint64_t* out, size_t n) {
+        check();
+        while (n && left) {
+            *out++ = buf[--left];
+            buf[left] = 0;
+            --n;
+        }
+        if (n >= CSPRNG_BUF_WORDS) {
+            run(out, n);
+            return;
+        }
+        for (size_t i = 0; i < n; i++) out[i] = next();
+    }
+
+    ~CsprngDrbg() {
+        csprng_wipe(key, sizeof(key));
+        csprng_wipe(buf, sizeof(buf));
+    }
+};
+
+inline CsprngDrbg& csprng_drbg() {
+    thread_local CsprngDrbg d;
+    return d;
+}
+
+inline uint64_t csprng_u64() {
+    return csprng_drbg().next();
+}
+
+inline void csprng_fill_u64(uint64_t * out, size_t n) {
+    csprng_drbg().fill(out, n);
+}
+
+#else
+
 inline uint64_t csprng_u64() {
     uint8_t b[8];
     csprng_bytes(b, 8);
     return load_le64(b);
 }
 
+inline void csprng_fill_u64(uint64_t * out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = csprng_u64();
+}
+
+#endif
+
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <vector>
 #include <array>
+#include <cstdlib>
+#include <iostream>
 
 #include "field.hpp"
 #include "bitvec.hpp"
@@ -15,6 +17,7 @@ namespace Dom {
     inline constexpr const char* H_GEN = "pvac.dom.h_gen";
     inline constexpr const char* X_SEED = "pvac.dom.x_seed";
     inline constexpr const char* NOISE = "pvac.dom.noise";
+    inline constexpr const char* PRG_V2 = "pvac.prg.v2";
     
     inline constexpr const char* PRF_LPN = "pvac.dom.prf_lpn";
     inline constexpr const char* TOEP = "pvac.dom.toeplitz";
@@ -45,6 +48,14 @@ struct Params {
     int x_col_wt = 128;
     int err_wt = 128;
 
+    // index sampler stream for H / sigma: 1 = sha256 counter (legacy),
+    // 2 = shake256 xof, keep 1 to reproduce keys made before v2
+    int prg_ver = 2;
+
+    // fresh edges keep only their sigma_from_H salt, the 1 KiB sigma is
+    // rebuilt on demand (edge_sigma / ct_expand_sigma)
+    bool lazy_sigma = false;
+
     double noise_entropy_bits = 120.0;
     double tuple2_fraction = 0.55;
     double depth_slope_bits = 16.0;
@@ -81,6 +92,10 @@ inline Nonce128 make_nonce128() {
 struct Ubk {
     std::vector<int> perm;
     std::vector<int> inv;
+
+    // benes stage masks for inv (see benes_build), built with the rest of
+    // ubk and never stored. empty unless m_bits is a power of two
+    std::vector<uint64_t> net;
 };
 
 struct RSeed {
@@ -111,6 +126,12 @@ struct Edge {
     uint8_t ch;
     Fp w;
     BitVec  s;
+
+    // salt given to sigma_from_H while the sigma is still the fresh one
+    // of (layer seed, idx, ch); dropped once the edge is xor merged or
+    // permuted. s may be left empty (nbits == 0) while salted
+    uint64_t salt = 0;
+    bool salted = false;
 };
 
 struct Cipher {
@@ -118,10 +139,26 @@ struct Cipher {
     std::vector<Edge> E;
 };
 
+// H in compressed column form: column c holds the sorted row indices
+// rows[col_ptr[c] .. col_ptr[c + 1]), m_bits <= 65536
+struct SparseH {
+    int m = 0;
+    std::vector<uint32_t> col_ptr;
+    std::vector<uint16_t> rows;
+
+    size_t size() const {
+        return col_ptr.empty() ? 0 : col_ptr.size() - 1;
+    }
+
+    size_t bytes() const {
+        return col_ptr.size() * sizeof(uint32_t) + rows.size() * sizeof(uint16_t);
+    }
+};
+
 struct PubKey {
     Params prm;
     uint64_t canon_tag;
-    std::vector<BitVec> H;
+    SparseH H;
     Ubk ubk;
     std::array<uint8_t, 32> H_digest;
     Fp omega_B;
@@ -138,6 +175,72 @@ struct EvalKey {
     Cipher enc_one;
 };
 
+// layer ids with every PROD layer after both of its parents. layers built
+// by ct_add / ct_mul already are in that order, anything else goes
+// through kahn. false on a cycle or a dangling parent. CT is a Cipher or
+// anything else with a random access L of Layer
+template <class CT>
+inline bool layer_topo_try(const CT& C, std::vector<uint32_t>& order) {
+    const uint32_t L = (uint32_t)C.L.size();
+    order.assign(L, 0);
+
+    bool sorted = true;
+    for (uint32_t lid = 0; lid < L; ++lid) {
+        const Layer& Lr = C.L[lid];
+        if (Lr.rule != RRule::PROD) continue;
+        if (Lr.pa >= L || Lr.pb >= L) return false;
+        if (Lr.pa >= lid || Lr.pb >= lid) sorted = false;
+    }
+
+    if (sorted) {
+        for (uint32_t lid = 0; lid < L; ++lid) order[lid] = lid;
+        return true;
+    }
+
+    // children in csr form, indeg counts parent edges (pa == pb counts twice)
+    std::vector<uint32_t> indeg(L, 0), off(L + 1, 0);
+    for (const auto& Lr : C.L) {
+        if (Lr.rule != RRule::PROD) continue;
+        off[Lr.pa + 1]++;
+        off[Lr.pb + 1]++;
+    }
+    for (uint32_t i = 0; i < L; ++i) off[i + 1] += off[i];
+
+    std::vector<uint32_t> kid(off[L]), pos(off.begin(), off.end() - 1);
+    for (uint32_t lid = 0; lid < L; ++lid) {
+        const Layer& Lr = C.L[lid];
+        if (Lr.rule != RRule::PROD) continue;
+        kid[pos[Lr.pa]++] = lid;
+        kid[pos[Lr.pb]++] = lid;
+        indeg[lid] = 2;
+    }
+
+    size_t head = 0, tail = 0;
+    for (uint32_t lid = 0; lid < L; ++lid) {
+        if (indeg[lid] == 0) order[tail++] = lid;
+    }
+
+    while (head < tail) {
+        uint32_t u = order[head++];
+        for (uint32_t k = off[u]; k < off[u + 1]; ++k) {
+            if (--indeg[kid[k]] == 0) order[tail++] = kid[k];
+        }
+    }
+
+    return tail == L;
+}
+
+// layer_topo_try for ciphers that must be well formed, aborts otherwise
+template <class CT>
+inline std::vector<uint32_t> layer_topo_order(const CT& C) {
+    std::vector<uint32_t> order;
+    if (!layer_topo_try(C, order)) {
+        std::cerr << "[topo] cycle or bad parent\n";
+        std::abort();
+    }
+    return order;
+}
+
 inline int sgn_val(uint8_t ch) {
     return (ch == SGN_P) ? +1 : -1;
 }
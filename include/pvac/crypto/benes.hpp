@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace pvac {
+
+// benes network for a permutation of n = 2^k bits: 2k - 1 stages of delta
+// swaps at distances n/2, n/4, ..., 1, ..., n/4, n/2. stage t is one row
+// of n/64 mask words with a bit at the lower position of every pair that
+// swaps. routed by the looping algorithm, so every permutation fits, and
+// a whole vector goes through in 2k - 1 passes of word wide ops instead
+// of one scatter per set bit
+
+inline int benes_log2(size_t n) {
+    if (n < 64 || (n & (n - 1)) != 0) {
+        return 0;
+    }
+
+    int k = 0;
+    while (((size_t)1 << k) < n) k++;
+    return k;
+}
+
+inline size_t benes_dist(int k, int t) {
+    return t < k ? ((size_t)1 << (k - 1 - t)) : ((size_t)1 << (t - k + 1));
+}
+
+// to[i] is where bit i ends up, base / lvl place the sub network
+inline void benes_route(const std::vector<int> & to, size_t base, int lvl, int k, size_t W,
+                        std::vector<uint64_t> & net) {
+    auto set = [&](int stage, size_t pos) {
+        net[(size_t)stage * W + (pos >> 6)] |= 1ull << (pos & 63);
+    };
+
+    const size_t n = to.size();
+
+    if (n == 2) {
+        if (to[0] == 1) set(k - 1, base);
+        return;
+    }
+
+    const size_t h = n / 2;
+    std::vector<int> from(n);
+    for (size_t i = 0; i < n; i++) from[(size_t)to[i]] = (int)i;
+
+    // side[i]: 0 when input i takes the upper sub network, 1 the lower.
+    // the two inputs of a switch split, so do the two sources of an
+    // output switch; follow that chain until it closes
+    std::vector<int8_t> side(n, -1);
+
+    for (size_t s = 0; s < h; s++) {
+        for (size_t i = s; side[i] < 0;) {
+            side[i] = 0;
+            side[i ^ h] = 1;
+            i = (size_t)from[(size_t)to[i ^ h] ^ h];
+        }
+    }
+
+    std::vector<int> up(h), lo(h);
+
+    for (size_t i = 0; i < n; i++) {
+        size_t d = (size_t)to[i];
+
+        if (side[i] == 0) {
+            up[i & (h - 1)] = (int)(d & (h - 1));
+            if (d >= h) set(2 * k - 2 - lvl, base + (d & (h - 1)));
+        } else {
+            lo[i & (h - 1)] = (int)(d & (h - 1));
+        }
+
+        if (i < h && side[i] == 1) set(lvl, base + i);
+    }
+
+    benes_route(up, base, lvl + 1, k, W, net);
+    benes_route(lo, base + h, lvl + 1, k, W, net);
+}
+
+// stage masks for to, empty when the size is not a power of two >= 64
+inline std::vector<uint64_t> benes_build(const std::vector<int> & to) {
+    int k = benes_log2(to.size());
+
+    if (!k) {
+        return {};
+    }
+
+    const size_t W = to.size() / 64;
+    std::vector<uint64_t> net((size_t)(2 * k - 1) * W, 0);
+    benes_route(to, 0, 0, k, W, net);
+    return net;
+}
+
+// one delta swap stage at distance d over W words
+inline void benes_stage(uint64_t * x, const uint64_t * m, size_t W, size_t d) {
+    if (d >= 64) {
+        const size_t D = d >> 6;
+        size_t w0 = 0;
+
+#if defined(__AVX512F__)
+        if (D >= 8) {
+            for (; w0 < W; w0 += 2 * D) {
+                for (size_t w = w0; w < w0 + D; w += 8) {
+                    __m512i a = _mm512_loadu_si512((const void *)(x + w));
+                    __m512i b = _mm512_loadu_si512((const void *)(x + w + D));
+                    __m512i s = _mm512_and_si512(_mm512_xor_si512(a, b), _mm512_loadu_si512((const void *)(m + w)));
+                    _mm512_storeu_si512((void *)(x + w), _mm512_xor_si512(a, s));
+                    _mm512_storeu_si512((void *)(x + w + D), _mm512_xor_si512(b, s));
+                }
+            }
+            return;
+        }
+#elif defined(__AVX2__)
+        if (D >= 4) {
+            for (; w0 < W; w0 += 2 * D) {
+                for (size_t w = w0; w < w0 + D; w += 4) {
+                    __m256i a = _mm256_loadu_si256((const __m256i *)(x + w));
+                    __m256i b = _mm256_loadu_si256((const __m256i *)(x + w + D));
+                    __m256i s = _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_loadu_si256((const __m256i *)(m + w)));
+                    _mm256_storeu_si256((__m256i *)(x + w), _mm256_xor_si256(a, s));
+                    _mm256_storeu_si256((__m256i *)(x + w + D), _mm256_xor_si256(b, s));
+                }
+            }
+            return;
+        }
+#endif
+        for (; w0 < W; w0 += 2 * D) {
+            for (size_t w = w0; w < w0 + D; w++) {
+                uint64_t s = (x[w] ^ x[w + D]) & m[w];
+                x[w] ^= s;
+                x[w + D] ^= s;
+            }
+        }
+        return;
+    }
+
+    size_t w = 0;
+
+#if defined(__AVX512F__)
+    const __m512i c = _mm512_set1_epi64((long long)d);
+    for (; w + 8 <= W; w += 8) {
+        __m512i a = _mm512_loadu_si512((const void *)(x + w));
+        __m512i s = _mm512_and_si512(_mm512_xor_si512(a, _mm512_maskz_srlv_epi64(0xff, a, c)), _mm512_loadu_si512((const void *)(m + w)));
+        _mm512_storeu_si512((void *)(x + w), _mm512_xor_si512(a, _mm512_xor_si512(s, _mm512_maskz_sllv_epi64(0xff, s, c))));
+    }
+#elif defined(__AVX2__)
+    const __m128i c = _mm_cvtsi64_si128((long long)d);
+    for (; w + 4 <= W; w += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(x + w));
+        __m256i s = _mm256_and_si256(_mm256_xor_si256(a, _mm256_srl_epi64(a, c)), _mm256_loadu_si256((const __m256i *)(m + w)));
+        _mm256_storeu_si256((__m256i *)(x + w), _mm256_xor_si256(a, _mm256_xor_si256(s, _mm256_sll_epi64(s, c))));
+    }
+#endif
+    for (; w < W; w++) {
+        uint64_t s = (x[w] ^ (x[w] >> d)) & m[w];
+        x[w] ^= s ^ (s << d);
+    }
+}
+
+// x (n / 64 words) permuted in place by the network of benes_build
+inline void benes_apply(const std::vector<uint64_t> & net, uint64_t * x, size_t n) {
+    const int k = benes_log2(n);
+    const size_t W = n / 64;
+
+    for (int t = 0; t < 2 * k - 1; t++) {
+        benes_stage(x, net.data() + (size_t)t * W, W, benes_dist(k, t));
+    }
+}
+
+// rows of n bits, stride words apart, each permuted in place. stage by
+// stage over a block of rows, so a mask row is loaded once per block
+inline void benes_apply_rows(const std::vector<uint64_t> & net, uint64_t * rows, size_t count,
+                             size_t stride, size_t n) {
+    const int k = benes_log2(n);
+    const size_t W = n / 64;
+    constexpr size_t BLOCK = 8;
+
+    for (size_t r0 = 0; r0 < count; r0 += BLOCK) {
+        size_t r1 = r0 + BLOCK < count ? r0 + BLOCK : count;
+
+        for (int t = 0; t < 2 * k - 1; t++) {
+            const uint64_t * m = net.data() + (size_t)t * W;
+            size_t d = benes_dist(k, t);
+
+            for (size_t r = r0; r < r1; r++) {
+                benes_stage(rows + r * stride, m, W, d);
+            }
+        }
+    }
+}
+
+}
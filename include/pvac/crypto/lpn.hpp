@@ -7,17 +7,10 @@
 
 #include "../core/types.hpp"
 #include "../core/hash.hpp"
+#include "../core/aes_ctr.hpp"
 #include "toeplitz.hpp"
 #include "../core/ct_safe.hpp"
 
-#if defined(__AES__) && defined(__SSE2__)
-#include <wmmintrin.h>
-#include <emmintrin.h>
-#define PVAC_USE_AESNI 1
-#else
-#define PVAC_USE_AESNI 0
-#endif
-
 namespace pvac {
 
 
@@ -36,122 +29,8 @@ inline Fp hash_to_fp_nonzero(uint64_t lo, uint64_t hi) {
     return out;
 }
 
-#if PVAC_USE_AESNI
-
-struct AesCtr256 {
-    __m128i rk[15];
-    __m128i ctr;
-    alignas(16) uint64_t buf[2] = {0, 0};
-    bool has_buf = false;
-
-    static inline __m128i key_expand(__m128i k, __m128i t) {
-        t = _mm_shuffle_epi32(t, 0xFF);
-        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
-        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
-        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
-        return _mm_xor_si128(k, t);
-    }
-
-    static inline __m128i key_expand2(__m128i k1, __m128i k2) {
-        __m128i t = _mm_aeskeygenassist_si128(k2, 0);
-        t = _mm_shuffle_epi32(t, 0xAA);
-        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
-        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
-        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
-        return _mm_xor_si128(k1, t);
-    }
-
-    void init(const uint8_t key[32], uint64_t nonce) {
-        __m128i k0 = _mm_loadu_si128((const __m128i*)key);
-        __m128i k1 = _mm_loadu_si128((const __m128i*)(key + 16));
-
-        rk[0] = k0;
-        rk[1] = k1;
-        rk[2] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x01)); k0 = rk[2];
-        rk[3] = key_expand2(k1, k0); k1 = rk[3];
-        rk[4] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x02)); k0 = rk[4];
-        rk[5] = key_expand2(k1, k0); k1 = rk[5];
-        rk[6] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x04)); k0 = rk[6];
-        rk[7] = key_expand2(k1, k0); k1 = rk[7];
-        rk[8] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x08)); k0 = rk[8];
-        rk[9] = key_expand2(k1, k0); k1 = rk[9];
-        rk[10] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x10)); k0 = rk[10];
-        rk[11] = key_expand2(k1, k0); k1 = rk[11];
-        rk[12] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x20)); k0 = rk[12];
-        rk[13] = key_expand2(k1, k0); k1 = rk[13];
-        rk[14] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x40));
-
-        ctr = _mm_set_epi64x(0, (long long)nonce);
-        has_buf = false;
-    }
-
-    inline __m128i encrypt_ctr() {
-        __m128i t = _mm_xor_si128(ctr, rk[0]);
-        t = _mm_aesenc_si128(t, rk[1]);
-        t = _mm_aesenc_si128(t, rk[2]);
-        t = _mm_aesenc_si128(t, rk[3]);
-        t = _mm_aesenc_si128(t, rk[4]);
-        t = _mm_aesenc_si128(t, rk[5]);
-        t = _mm_aesenc_si128(t, rk[6]);
-        t = _mm_aesenc_si128(t, rk[7]);
-        t = _mm_aesenc_si128(t, rk[8]);
-        t = _mm_aesenc_si128(t, rk[9]);
-        t = _mm_aesenc_si128(t, rk[10]);
-        t = _mm_aesenc_si128(t, rk[11]);
-        t = _mm_aesenc_si128(t, rk[12]);
-        t = _mm_aesenc_si128(t, rk[13]);
-        t = _mm_aesenclast_si128(t, rk[14]);
-        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, 1));
-        return t;
-    }
-
-    inline uint64_t next_u64() {
-        if (has_buf) {
-            has_buf = false;
-            return buf[1];
-        }
-        __m128i ct = encrypt_ctr();
-        _mm_store_si128((__m128i*)buf, ct);
-        has_buf = true;
-        return buf[0];
-    }
-
-    inline void fill_u64(uint64_t* out, size_t n) {
-        size_t i = 0;
-        if (has_buf && n > 0) {
-            out[0] = buf[1];
-            has_buf = false;
-            i = 1;
-        }
-        alignas(16) uint64_t tmp[2];
-        for (; i + 1 < n; i += 2) {
-            __m128i ct = encrypt_ctr();
-            _mm_store_si128((__m128i*)tmp, ct);
-            out[i] = tmp[0];
-            out[i + 1] = tmp[1];
-        }
-        if (i < n) {
-            __m128i ct = encrypt_ctr();
-            _mm_store_si128((__m128i*)buf, ct);
-            out[i] = buf[0];
-            has_buf = true;
-        }
-    }
-
-    inline uint64_t bounded(uint64_t M) {
-        if (M <= 1) return 0;
-        uint64_t lim = UINT64_MAX - (UINT64_MAX % M);
-        for (;;) {
-            uint64_t x = next_u64();
-            if (x < lim) return x % M;
-        }
-    }
-};
-
-#else
-
+#if !PVAC_USE_AESNI
 #error "hfhe requires aes-ni support (compile with -march=native or -maes on x86_64)"
-
 #endif
 
 inline uint64_t fnv1a_domain(const char* dom) {
@@ -214,16 +93,10 @@ inline void lpn_make_ybits(
     int num = pk.prm.lpn_tau_num;
     int den = pk.prm.lpn_tau_den;
 
-    std::vector<uint64_t> row_buf(s_words);
+    const uint64_t* s = sk.lpn_s_bits.data();
 
     for (int r = 0; r < t; r++) {
-        prg.fill_u64(row_buf.data(), s_words);
-
-        uint64_t acc = 0;
-        for (size_t wi = 0; wi < s_words; ++wi) {
-            acc ^= row_buf[wi] & sk.lpn_s_bits[wi];
-        }
-        int dot = parity64(acc);
+        int dot = parity64(prg.and_xor_u64(s, s_words));
 
         int e = (prg.bounded((uint64_t)den) < (uint64_t)num) ? 1 : 0;
         int y = dot ^ e;
@@ -238,7 +111,9 @@ inline Fp prf_R_core(
     const RSeed& seed,
     const char* dom
 ) {
-    std::vector<uint64_t> ybits;
+    // per thread scratch, reused across calls
+    thread_local std::vector<uint64_t> ybits;
+    thread_local std::vector<uint64_t> top;
     lpn_make_ybits(pk, sk, seed, dom, ybits);
 
     uint8_t toep_key[32];
@@ -250,13 +125,17 @@ inline Fp prf_R_core(
     prg.init(toep_key, toep_nonce);
 
     size_t top_words = ((size_t)pk.prm.lpn_t + 127u + 63u) / 64u;
-    std::vector<uint64_t> top(top_words);
+    top.resize(top_words);
     prg.fill_u64(top.data(), top_words);
 
     uint64_t lo = 0;
     uint64_t hi = 0;
     toep_127(top, ybits, lo, hi);
 
+    // secret derived, do not leave them in the scratch for the thread's life
+    csprng_wipe(ybits.data(), ybits.size() * 8);
+    csprng_wipe(top.data(), top.size() * 8);
+
     return hash_to_fp_nonzero(lo, hi);
 }
 
@@ -274,4 +153,152 @@ inline Fp prf_R_noise(const PubKey& pk, const SecKey& sk, const RSeed& seed) {
     return fp_mul(fp_mul(r1, r2), r3);
 }
 
+// multi-seed prf: up to PRF_LANES (seed, dom) jobs share one pass. the
+// row streams of all jobs are interleaved block by block through the fused
+// and-xor kernel, so one load of the secret serves every lane, and so are
+// the toeplitz keystreams; outputs are identical to prf_R_core per job
+
+inline constexpr size_t PRF_LANES = 8;
+
+struct PrfJob {
+    RSeed seed;
+    const char* dom;
+};
+
+inline void prf_core_lanes(
+    const PubKey& pk,
+    const SecKey& sk,
+    const PrfJob* jobs,
+    size_t n,
+    Fp* out
+) {
+    int t = pk.prm.lpn_t;
+    size_t s_words = ((size_t)pk.prm.lpn_n + 63) / 64;
+    uint64_t num = (uint64_t)pk.prm.lpn_tau_num;
+    uint64_t den = (uint64_t)pk.prm.lpn_tau_den;
+
+    AesCtr256 prg[PRF_LANES];
+    AesCtr256* p[PRF_LANES] = {};
+    thread_local std::vector<uint64_t> ybits[PRF_LANES];
+
+    for (size_t l = 0; l < n; ++l) {
+        uint8_t key[32];
+        uint64_t nonce;
+        derive_aes_key(pk, sk, jobs[l].seed, jobs[l].dom, key, nonce);
+        prg[l].init(key, nonce);
+        p[l] = &prg[l];
+        ybits[l].assign(((size_t)t + 63) / 64, 0ull);
+    }
+
+    AesCtrLanes rows;
+    rows.init(p, n);
+
+    const uint64_t* s = sk.lpn_s_bits.data();
+    uint64_t x[PRF_LANES];
+
+    for (int r = 0; r < t; r++) {
+        rows.and_xor(s, s_words, x);
+
+        for (size_t l = 0; l < n; ++l) {
+            int e = (prg[l].bounded(den) < num) ? 1 : 0;
+            ybits[l][r >> 6] ^= ((uint64_t)(parity64(x[l]) ^ e)) << (r & 63);
+        }
+    }
+
+    size_t top_words = ((size_t)t + 127u + 63u) / 64u;
+    size_t top_blocks = (top_words + 1) / 2;
+    thread_local std::vector<uint64_t> top[PRF_LANES];
+    uint64_t* o[PRF_LANES] = {};
+
+    for (size_t l = 0; l < n; ++l) {
+        uint8_t key[32];
+        uint64_t nonce;
+        derive_aes_key(pk, sk, jobs[l].seed, Dom::TOEP, key, nonce);
+        nonce ^= fnv1a_domain(jobs[l].dom);
+
+        prg[l].init(key, nonce);
+        top[l].resize(2 * top_blocks);
+        p[l] = &prg[l];
+        o[l] = top[l].data();
+    }
+
+    AesCtr256::fill_lanes(p, o, n, top_blocks);
+
+    for (size_t l = 0; l < n; ++l) {
+        top[l].resize(top_words);
+
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+        toep_127(top[l], ybits[l], lo, hi);
+        out[l] = hash_to_fp_nonzero(lo, hi);
+
+        csprng_wipe(ybits[l].data(), ybits[l].size() * 8);
+        csprng_wipe(top[l].data(), top[l].size() * 8);
+    }
+}
+
+inline void prf_core_batch(
+    const PubKey& pk,
+    const SecKey& sk,
+    const std::vector<PrfJob>& jobs,
+    std::vector<Fp>& out
+) {
+    out.resize(jobs.size());
+
+    for (size_t i = 0; i < jobs.size(); i += PRF_LANES) {
+        size_t n = std::min(PRF_LANES, jobs.size() - i);
+        prf_core_lanes(pk, sk, jobs.data() + i, n, out.data() + i);
+    }
+}
+
+inline std::vector<Fp> prf_R_core_batch(
+    const PubKey& pk,
+    const SecKey& sk,
+    const std::vector<RSeed>& seeds,
+    const char* dom
+) {
+    std::vector<PrfJob> jobs;
+    jobs.reserve(seeds.size());
+    for (const auto& s : seeds) jobs.push_back({s, dom});
+
+    std::vector<Fp> out;
+    prf_core_batch(pk, sk, jobs, out);
+    return out;
+}
+
+// three-domain product per seed, same as prf_R / prf_R_noise
+inline std::vector<Fp> prf_R3_batch(
+    const PubKey& pk,
+    const SecKey& sk,
+    const std::vector<RSeed>& seeds,
+    const char* d1,
+    const char* d2,
+    const char* d3
+) {
+    std::vector<PrfJob> jobs;
+    jobs.reserve(seeds.size() * 3);
+    for (const auto& s : seeds) {
+        jobs.push_back({s, d1});
+        jobs.push_back({s, d2});
+        jobs.push_back({s, d3});
+    }
+
+    std::vector<Fp> r;
+    prf_core_batch(pk, sk, jobs, r);
+
+    std::vector<Fp> out(seeds.size());
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        out[i] = fp_mul(fp_mul(r[3 * i], r[3 * i + 1]), r[3 * i + 2]);
+    }
+    return out;
+}
+
+inline std::vector<Fp> prf_R_batch(const PubKey& pk, const SecKey& sk, const std::vector<RSeed>& seeds) {
+    return prf_R3_batch(pk, sk, seeds, Dom::PRF_R1, Dom::PRF_R2, Dom::PRF_R3);
+}
+
+inline std::vector<Fp> prf_R_noise_batch(const PubKey& pk, const SecKey& sk, const std::vector<RSeed>& seeds) {
+    return prf_R3_batch(pk, sk, seeds, Dom::PRF_NOISE1, Dom::PRF_NOISE2, Dom::PRF_NOISE3);
+}
+
 }
\ No newline at end of file
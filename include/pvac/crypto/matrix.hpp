@@ -4,15 +4,21 @@
 #include <cstring>
 #include <vector>
 #include <unordered_set>
+#include <string>
 #include <numeric>
+#include <algorithm>
+#include <cstdlib>
 
 #include "../core/types.hpp"
 #include "../core/hash.hpp"
+#include "../core/parallel.hpp"
+#include "benes.hpp"
 
 namespace pvac {
 
-// select k unique indices from [0, N)
-inline std::vector<int> prg_choose_k(
+// select k unique indices from [0, N), legacy v1 stream:
+// sha256(label | words | ctr) per 32 output bytes
+inline std::vector<int> prg_choose_k_v1(
     int k,
     int N,
     const char * label,
@@ -91,6 +97,193 @@ inline std::vector<int> prg_choose_k(
     return out;
 }
 
+struct PrgReq {
+    int k;
+    int N;
+    const char * label;
+    const uint64_t * w;
+    size_t nw;
+};
+
+// v2 stream: shake256(PRG_V2 | label | words) absorbed once, each
+// squeezed block read as 34 le u32 draws, reduced by multiply-shift
+// with rejection, duplicates dropped through a bitmap over [0, N)
+struct PrgDraw {
+    static constexpr size_t RATE_W = 17;
+
+    const PrgReq * rq;
+    uint32_t thr;
+    uint64_t * bm;
+    std::vector<int> * out;
+
+    void begin(const PrgReq & r, std::vector<uint64_t> & bits, std::vector<int> & o) {
+        if (r.N <= 0 || r.k > r.N) {
+            std::abort();
+        }
+
+        rq = &r;
+        thr = (uint32_t)(0u - (uint32_t)r.N) % (uint32_t)r.N;
+        bits.resize(std::max(bits.size(), ((size_t)r.N + 63) / 64), 0);
+        bm = bits.data();
+        out = &o;
+        out->clear();
+        out->reserve(r.k);
+    }
+
+    bool full() const {
+        return (int)out->size() >= rq->k;
+    }
+
+    // true once k indices are out
+    bool eat(const uint64_t * blk) {
+        for (size_t i = 0; i < RATE_W; i++) {
+            uint64_t x = blk[i];
+
+            for (int h = 0; h < 2 && !full(); h++, x >>= 32) {
+                uint64_t m = (x & 0xFFFFFFFFull) * (uint64_t)rq->N;
+
+                if ((uint32_t)m < thr) {
+                    continue;
+                }
+
+                uint32_t v = (uint32_t)(m >> 32);
+                uint64_t b = 1ull << (v & 63);
+
+                if (!(bm[v >> 6] & b)) {
+                    bm[v >> 6] |= b;
+                    out->push_back((int)v);
+                }
+            }
+        }
+
+        return full();
+    }
+
+    // leave the bitmap zero for the next call
+    void end() {
+        for (int v : *out) {
+            bm[(size_t)v >> 6] = 0;
+        }
+    }
+};
+
+// xor the padded message into st, permuting between blocks but not
+// after the last one, the caller's first permute finishes absorbing
+inline void prg_v2_absorb(uint64_t st[25], const PrgReq & rq) {
+    const size_t rate = PrgDraw::RATE_W * 8;
+
+    thread_local std::vector<uint8_t> msg;
+    msg.clear();
+
+    size_t tl = std::strlen(Dom::PRG_V2);
+    size_t ll = std::strlen(rq.label);
+
+    msg.insert(msg.end(), Dom::PRG_V2, Dom::PRG_V2 + tl);
+    msg.insert(msg.end(), rq.label, rq.label + ll);
+
+    for (size_t i = 0; i < rq.nw; i++) {
+        uint8_t b[8];
+        store_le64(b, rq.w[i]);
+        msg.insert(msg.end(), b, b + 8);
+    }
+
+    msg.push_back(0x1F);
+    msg.resize((msg.size() + rate - 1) / rate * rate, 0);
+    msg.back() |= 0x80;
+
+    std::fill(st, st + 25, 0);
+
+    for (size_t off = 0; off < msg.size(); off += rate) {
+        if (off) {
+            Shake256::permute(st);
+        }
+
+        for (size_t j = 0; j < PrgDraw::RATE_W; j++) {
+            st[j] ^= load_le64(&msg[off + 8 * j]);
+        }
+    }
+}
+
+// v2 for cnt independent requests, squeezed four at a time
+// through Keccak4, out[i] matches a lone call on rq[i]
+inline void prg_choose_k_batch(const PrgReq * rq, size_t cnt, std::vector<int> * out) {
+    thread_local std::vector<uint64_t> bits[4];
+
+    for (size_t g = 0; g < cnt; g += 4) {
+        size_t nl = std::min((size_t)4, cnt - g);
+        PrgDraw d[4];
+        uint64_t st[4][25];
+        bool live[4] = { false, false, false, false };
+        size_t left = 0;
+
+        for (size_t l = 0; l < nl; l++) {
+            d[l].begin(rq[g + l], bits[l], out[g + l]);
+            prg_v2_absorb(st[l], rq[g + l]);
+            live[l] = !d[l].full();
+            left += live[l];
+        }
+
+        if (nl == 1) {
+            while (left) {
+                Shake256::permute(st[0]);
+                left -= d[0].eat(st[0]);
+            }
+        } else {
+            Keccak4::v4 A[25] = {};
+
+            for (size_t l = 0; l < nl; l++) {
+                for (int i = 0; i < 25; i++) {
+                    A[i][l] = st[l][i];
+                }
+            }
+
+            while (left) {
+                Keccak4::permute(A);
+
+                for (size_t l = 0; l < nl; l++) {
+                    if (!live[l]) {
+                        continue;
+                    }
+
+                    uint64_t blk[PrgDraw::RATE_W];
+
+                    for (size_t i = 0; i < PrgDraw::RATE_W; i++) {
+                        blk[i] = A[i][l];
+                    }
+
+                    if (d[l].eat(blk)) {
+                        live[l] = false;
+                        left--;
+                    }
+                }
+            }
+        }
+
+        for (size_t l = 0; l < nl; l++) {
+            d[l].end();
+        }
+    }
+}
+
+// select k unique indices from [0, N) with sampler version ver
+inline std::vector<int> prg_choose_k(
+    int k,
+    int N,
+    const char * label,
+    const std::vector<uint64_t> & words,
+    int ver = 2
+) {
+    if (ver == 1) {
+        return prg_choose_k_v1(k, N, label, words);
+    }
+
+    PrgReq rq { k, N, label, words.data(), words.size() };
+    std::vector<int> out;
+    prg_choose_k_batch(&rq, 1, &out);
+
+    return out;
+}
+
 // public permutation from canon_tag
 inline Ubk gen_ubk_public(uint64_t canon_tag, int m_bits) {
     std::vector<int> perm(m_bits);
@@ -157,6 +350,7 @@ inline Ubk gen_ubk_public(uint64_t canon_tag, int m_bits) {
     }
 
     Ubk u;
+    u.net = benes_build(inv);
     u.perm = std::move(perm);
     u.inv = std::move(inv);
 
@@ -165,6 +359,24 @@ inline Ubk gen_ubk_public(uint64_t canon_tag, int m_bits) {
 
 // apply inverse permutation to bitvec
 inline BitVec apply_perm_sigma(const BitVec & v, const std::vector<int> & inv) {
+    // full width: every set bit is in range, a fixed trip count and no
+    // bound check per bit. the scatter lands in an aligned per thread
+    // SigmaBits row and goes out in one copy
+    if (v.nbits == SIGMA_BITS && v.w.size() == SIGMA_W) {
+        thread_local SigmaBits t;
+        const int * p = inv.data();
+        t.clear();
+
+        for (size_t wi = 0; wi < SIGMA_W; ++wi) {
+            for (uint64_t x = v.w[wi]; x; x &= x - 1) {
+                int j = p[(wi << 6) + (size_t)__builtin_ctzll(x)];
+                t.w[(size_t)j >> 6] |= (1ull << (j & 63));
+            }
+        }
+
+        return t.to_bitvec();
+    }
+
     BitVec o = BitVec::make(v.nbits);
 
     for (size_t wi = 0; wi < v.w.size(); ++wi) {
@@ -187,67 +399,154 @@ inline BitVec apply_perm_sigma(const BitVec & v, const std::vector<int> & inv) {
     return o;
 }
 
-// sparse parity check
-inline void gen_H(PubKey & pk) {
-    int m = pk.prm.m_bits;
-    int n = pk.prm.n_bits;
-    int wt = pk.prm.h_col_wt;
+inline BitVec h_col_dense(const SparseH & H, size_t c) {
+    BitVec col = BitVec::make((size_t)H.m);
+
+    for (uint32_t k = H.col_ptr[c]; k < H.col_ptr[c + 1]; k++) {
+        uint16_t r = H.rows[k];
+        col.w[(size_t)r >> 6] |= (1ull << (r & 63));
+    }
 
-    pk.H.resize(n, BitVec::make(m));
+    return col;
+}
 
-    for (int c = 0; c < n; c++) {
-        BitVec col = BitVec::make(m);
+inline std::vector<BitVec> h_to_dense(const SparseH & H) {
+    std::vector<BitVec> out;
+    out.reserve(H.size());
 
-        std::vector<uint64_t> words {
-            (uint64_t)m,
-            (uint64_t)n,
-            (uint64_t)wt,
-            (uint64_t)c,
-            pk.canon_tag
-        };
+    for (size_t c = 0; c < H.size(); c++) {
+        out.push_back(h_col_dense(H, c));
+    }
+
+    return out;
+}
+
+inline SparseH h_from_dense(const std::vector<BitVec> & cols, int m) {
+    if (m > 65536) {
+        std::abort();
+    }
+
+    SparseH H;
+    H.m = m;
+    H.col_ptr.reserve(cols.size() + 1);
+    H.col_ptr.push_back(0);
 
-        auto rows = prg_choose_k(wt, m, Dom::H_GEN, words);
+    for (const auto & col : cols) {
+        for (size_t wi = 0; wi < col.w.size(); ++wi) {
+            uint64_t x = col.w[wi];
 
-        for (int r : rows) {
-            col.w[(size_t)r >> 6] |= (1ull << (r & 63));
+            while (x) {
+                size_t r = (wi << 6) + (size_t)__builtin_ctzll(x);
+                if (r < (size_t)m) {
+                    H.rows.push_back((uint16_t)r);
+                }
+                x &= x - 1;
+            }
         }
 
-        pk.H[c] = std::move(col);
+        H.col_ptr.push_back((uint32_t)H.rows.size());
     }
 
-    // digest for verif
+    return H;
+}
+
+// digest for verif, over the dense column bytes
+inline void h_digest(const Params & prm, const SparseH & H, uint8_t out[32]) {
     Sha256 s;
-    
+
     s.init();
     s.update("H|v2", 4);
-    sha256_acc_u64(s, pk.prm.m_bits);
-    sha256_acc_u64(s, pk.prm.n_bits);
-    sha256_acc_u64(s, pk.prm.h_col_wt);
-
-    for (const auto & col : pk.H) {
-        size_t bytes = (col.nbits + 7) / 8;
-        size_t full = bytes / 8;
-        size_t rem = bytes % 8;
-
-        for (size_t i = 0; i < full; i++) {
-            uint8_t b[8];
-            store_le64(b, col.w[i]);
-            s.update(b, 8);
+    sha256_acc_u64(s, prm.m_bits);
+    sha256_acc_u64(s, prm.n_bits);
+    sha256_acc_u64(s, prm.h_col_wt);
+
+    BitVec col = BitVec::make(H.m);
+    size_t bytes = (col.nbits + 7) / 8;
+    std::vector<uint8_t> cb(col.w.size() * 8);
+
+    for (size_t c = 0; c < H.size(); c++) {
+        for (uint32_t k = H.col_ptr[c]; k < H.col_ptr[c + 1]; k++) {
+            col.w[H.rows[k] >> 6] |= (1ull << (H.rows[k] & 63));
         }
 
-        if (rem) {
-            uint8_t b[8];
-            uint64_t x = col.w[full];
+        for (size_t i = 0; i < col.w.size(); i++) {
+            store_le64(&cb[8 * i], col.w[i]);
+        }
 
-            for (size_t j = 0; j < rem; j++) {
-                b[j] = (uint8_t)((x >> (8 * j)) & 0xFF);
-            }
+        s.update(cb.data(), bytes);
 
-            s.update(b, rem);
+        for (uint32_t k = H.col_ptr[c]; k < H.col_ptr[c + 1]; k++) {
+            col.w[H.rows[k] >> 6] = 0;
         }
     }
 
-    s.finish(pk.H_digest.data());
+    s.finish(out);
+}
+
+// sparse parity check, kept as row indices (h_col_wt per column).
+// every column has exactly wt rows, so workers fill disjoint slices
+inline void gen_H(PubKey & pk) {
+    int m = pk.prm.m_bits;
+    int n = pk.prm.n_bits;
+    int wt = pk.prm.h_col_wt;
+
+    if (m > 65536) {
+        std::abort();
+    }
+
+    SparseH & H = pk.H;
+    H.m = m;
+    H.col_ptr.resize((size_t)n + 1);
+    H.rows.assign((size_t)n * wt, 0);
+
+    for (int c = 0; c <= n; c++) {
+        H.col_ptr[c] = (uint32_t)((size_t)c * wt);
+    }
+
+    // four columns per batch, their streams are independent
+    parallel_for(((size_t)n + 3) / 4, 64, [&](size_t lo, size_t hi) {
+        for (size_t g = lo; g < hi; g++) {
+            int c0 = (int)(4 * g);
+            int nc = std::min(4, n - c0);
+            uint64_t words[4][5];
+            PrgReq rq[4];
+            std::vector<int> rows[4];
+
+            for (int l = 0; l < nc; l++) {
+                uint64_t w[5] = {
+                    (uint64_t)m,
+                    (uint64_t)n,
+                    (uint64_t)wt,
+                    (uint64_t)(c0 + l),
+                    pk.canon_tag
+                };
+
+                std::memcpy(words[l], w, sizeof(w));
+                rq[l] = PrgReq { wt, m, Dom::H_GEN, words[l], 5 };
+            }
+
+            if (pk.prm.prg_ver == 1) {
+                for (int l = 0; l < nc; l++) {
+                    rows[l] = prg_choose_k_v1(wt, m, Dom::H_GEN,
+                        std::vector<uint64_t>(words[l], words[l] + 5));
+                }
+            } else {
+                prg_choose_k_batch(rq, (size_t)nc, rows);
+            }
+
+            for (int l = 0; l < nc; l++) {
+                std::sort(rows[l].begin(), rows[l].end());
+
+                uint16_t * dst = &H.rows[H.col_ptr[c0 + l]];
+
+                for (int k = 0; k < wt; k++) {
+                    dst[k] = (uint16_t)rows[l][k];
+                }
+            }
+        }
+    });
+
+    h_digest(pk.prm, H, pk.H_digest.data());
 }
 
 // canon_tag + nonce
@@ -287,13 +586,33 @@ inline BitVec sigma_from_H(
         salt //same?
     };
 
-    auto cols = prg_choose_k(pk.prm.x_col_wt, n, Dom::X_SEED, words);
+    // column and noise draws share one 4-way squeeze
+    std::vector<int> pick[2];
 
-    for (int c : cols) {
-        s.xor_with(pk.H[c]);
+    if (pk.prm.prg_ver == 1) {
+        pick[0] = prg_choose_k_v1(pk.prm.x_col_wt, n, Dom::X_SEED, words);
+        pick[1] = prg_choose_k_v1(pk.prm.err_wt, m, Dom::NOISE, words);
+    } else {
+        PrgReq rq[2] = {
+            { pk.prm.x_col_wt, n, Dom::X_SEED, words.data(), words.size() },
+            { pk.prm.err_wt, m, Dom::NOISE, words.data(), words.size() }
+        };
+        prg_choose_k_batch(rq, 2, pick);
     }
 
-    auto noise = prg_choose_k(pk.prm.err_wt, m, Dom::NOISE, words);
+    const auto & cols = pick[0];
+    const auto & noise = pick[1];
+
+    // scatter the column rows instead of xoring dense columns
+    const uint32_t * cp = pk.H.col_ptr.data();
+    const uint16_t * hr = pk.H.rows.data();
+    uint64_t * sw = s.w.data();
+
+    for (int c : cols) {
+        for (uint32_t k = cp[c]; k < cp[c + 1]; k++) {
+            sw[hr[k] >> 6] ^= (1ull << (hr[k] & 63));
+        }
+    }
 
     for (int r : noise) {
         s.w[(size_t)r >> 6] ^= (1ull << (r & 63));
@@ -302,11 +621,70 @@ inline BitVec sigma_from_H(
     return s;
 }
 
-// permutation to all edges in ct
-inline void ubk_apply(const PubKey & pk, Cipher & C) {
+inline bool edge_sigma_lazy(const Edge & e) {
+    return e.salted && e.s.nbits == 0;
+}
+
+// sigma of e, rebuilt from its layer seed and salt when not kept
+inline BitVec edge_sigma(const PubKey & pk, const Cipher & C, const Edge & e) {
+    if (!edge_sigma_lazy(e)) {
+        return e.s;
+    }
+
+    const RSeed & sd = C.L[e.layer_id].seed;
+    return sigma_from_H(pk, sd.ztag, sd.nonce, e.idx, e.ch, e.salt);
+}
+
+// rebuild every dropped sigma
+inline void ct_expand_sigma(const PubKey & pk, Cipher & C) {
+    parallel_for(C.E.size(), 16, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            if (edge_sigma_lazy(C.E[i])) {
+                C.E[i].s = edge_sigma(pk, C, C.E[i]);
+            }
+        }
+    });
+}
+
+// drop the sigma of every salted edge, returns how many were dropped
+inline size_t ct_strip_sigma(Cipher & C) {
+    size_t n = 0;
+
     for (auto & e : C.E) {
-        e.s = apply_perm_sigma(e.s, pk.ubk.inv);
+        if (e.salted && e.s.nbits) {
+            e.s = BitVec {};
+            n++;
+        }
+    }
+
+    return n;
+}
+
+// through the network when u has one and v is full size, in place
+inline void apply_perm_sigma_inplace(BitVec & v, const Ubk & u) {
+    if (!u.net.empty() && v.nbits == u.inv.size() && v.w.size() == v.nbits / 64) {
+        benes_apply(u.net, v.w.data(), v.nbits);
+    } else {
+        v = apply_perm_sigma(v, u.inv);
     }
 }
 
-}
\ No newline at end of file
+inline BitVec apply_perm_sigma(const BitVec & v, const Ubk & u) {
+    BitVec o = v;
+    apply_perm_sigma_inplace(o, u);
+    return o;
+}
+
+// permutation to all edges in ct, sigmas permuted where they are
+inline void ubk_apply(const PubKey & pk, Cipher & C) {
+    ct_expand_sigma(pk, C);
+
+    parallel_for(C.E.size(), 16, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            apply_perm_sigma_inplace(C.E[i].s, pk.ubk);
+            C.E[i].salted = false;
+        }
+    });
+}
+
+}
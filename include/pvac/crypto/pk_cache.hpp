@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <type_traits>
+
+#include "../core/types.hpp"
+#include "../core/ct_safe.hpp"
+#include "../core/mapped_file.hpp"
+
+#include "matrix.hpp"
+
+namespace pvac {
+
+// binary PubKey cache, all integers le:
+//   "PVACPK\0\0" | u32 ver | params | canon_tag | H_digest[32]
+//   | m | ncols | nrows | col_ptr u32[] | rows u16[]
+//   | perm u32[m] | inv u32[m] | omega_B | npow | powg_B[]
+// loading range checks params, checks every H column is h_col_wt strictly
+// rising rows, recomputes H_digest from them instead of gen_H, rebuilds
+// ubk from canon_tag and checks the powg_B chain
+
+inline constexpr uint32_t PK_CACHE_VER = 2;
+
+namespace pkc {
+
+struct Out {
+    std::vector<uint8_t> b;
+
+    void raw(const void * p, size_t n) {
+        const uint8_t * q = (const uint8_t *)p;
+        b.insert(b.end(), q, q + n);
+    }
+
+    void u64(uint64_t x) {
+        uint8_t t[8];
+        store_le64(t, x);
+        raw(t, 8);
+    }
+
+    void u32(uint32_t x) {
+        uint8_t t[4] = { (uint8_t)x, (uint8_t)(x >> 8), (uint8_t)(x >> 16), (uint8_t)(x >> 24) };
+        raw(t, 4);
+    }
+
+    void u16(uint16_t x) {
+        uint8_t t[2] = { (uint8_t)x, (uint8_t)(x >> 8) };
+        raw(t, 2);
+    }
+
+    void f64(double x) {
+        uint64_t u;
+        std::memcpy(&u, &x, 8);
+        u64(u);
+    }
+
+    void fp(const Fp & x) {
+        u64(x.lo);
+        u64(x.hi);
+    }
+};
+
+struct In {
+    const uint8_t * p;
+    size_t left;
+    bool ok = true;
+
+    const uint8_t * take(size_t n) {
+        if (!ok || n > left) {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t * q = p;
+        p += n;
+        left -= n;
+        return q;
+    }
+
+    uint64_t u64() {
+        const uint8_t * q = take(8);
+        return q ? load_le64(q) : 0;
+    }
+
+    uint32_t u32() {
+        const uint8_t * q = take(4);
+        return q ? (uint32_t)q[0] | (uint32_t)q[1] << 8 | (uint32_t)q[2] << 16 | (uint32_t)q[3] << 24 : 0;
+    }
+
+    uint16_t u16() {
+        const uint8_t * q = take(2);
+        return q ? (uint16_t)(q[0] | q[1] << 8) : 0;
+    }
+
+    double f64() {
+        uint64_t u = u64();
+        double x;
+        std::memcpy(&x, &u, 8);
+        return x;
+    }
+
+    Fp fp() {
+        Fp x;
+        x.lo = u64();
+        x.hi = u64();
+        return x;
+    }
+};
+
+template <class IO, class P>
+inline void params_io(IO & io, P & prm) {
+    io(prm.B);
+    io(prm.m_bits);
+    io(prm.n_bits);
+    io(prm.h_col_wt);
+    io(prm.x_col_wt);
+    io(prm.err_wt);
+    io(prm.prg_ver);
+    io(prm.lazy_sigma);
+    io(prm.noise_entropy_bits);
+    io(prm.tuple2_fraction);
+    io(prm.depth_slope_bits);
+    io(prm.edge_budget);
+    io(prm.lpn_n);
+    io(prm.lpn_t);
+    io(prm.lpn_tau_num);
+    io(prm.lpn_tau_den);
+    io(prm.recrypt_lo);
+    io(prm.recrypt_hi);
+    io(prm.recrypt_rounds);
+}
+
+// every params_io field of a and b, bit for bit
+inline bool params_eq(const Params & a, const Params & b) {
+    std::vector<uint64_t> x, y;
+    auto put = [](std::vector<uint64_t> & v) {
+        return [&v](auto f) {
+            if constexpr (std::is_floating_point_v<decltype(f)>) {
+                uint64_t u;
+                std::memcpy(&u, &f, 8);
+                v.push_back(u);
+            } else {
+                v.push_back((uint64_t)(int64_t)f);
+            }
+        };
+    };
+    auto px = put(x), py = put(y);
+    params_io(px, a);
+    params_io(py, b);
+    return x == y;
+}
+
+// ranges the rest of the key and the samplers rely on
+inline bool params_ok(const Params & p) {
+    return p.B > 1 && p.m_bits > 0 && p.m_bits <= 65536 && p.n_bits > 0 &&
+           p.h_col_wt > 0 && p.h_col_wt <= p.m_bits &&
+           p.x_col_wt > 0 && p.x_col_wt <= p.n_bits &&
+           p.err_wt >= 0 && p.err_wt <= p.m_bits &&
+           (p.prg_ver == 1 || p.prg_ver == 2) &&
+           p.lpn_n > 0 && p.lpn_t > 0 &&
+           p.lpn_tau_den > 0 && p.lpn_tau_num >= 0 && p.lpn_tau_num <= p.lpn_tau_den &&
+           p.edge_budget > 0 && p.recrypt_rounds >= 0 &&
+           p.recrypt_lo >= 0.0 && p.recrypt_lo <= p.recrypt_hi && p.recrypt_hi <= 1.0 &&
+           p.noise_entropy_bits >= 0.0 && p.tuple2_fraction >= 0.0 && p.tuple2_fraction <= 1.0 &&
+           p.depth_slope_bits >= 0.0;
+}
+
+}
+
+inline bool pk_cache_save(const PubKey & pk, const std::string & path) {
+    pkc::Out o;
+    o.raw("PVACPK\0\0", 8);
+    o.u32(PK_CACHE_VER);
+
+    auto put = [&](auto x) {
+        if constexpr (std::is_floating_point_v<decltype(x)>) {
+            o.f64(x);
+        } else {
+            o.u64((uint64_t)(int64_t)x);
+        }
+    };
+    pkc::params_io(put, pk.prm);
+
+    o.u64(pk.canon_tag);
+    o.raw(pk.H_digest.data(), 32);
+
+    o.u32((uint32_t)pk.H.m);
+    o.u32((uint32_t)pk.H.size());
+    o.u32((uint32_t)pk.H.rows.size());
+
+    for (uint32_t x : pk.H.col_ptr) o.u32(x);
+    for (uint16_t x : pk.H.rows) o.u16(x);
+    for (int x : pk.ubk.perm) o.u32((uint32_t)x);
+    for (int x : pk.ubk.inv) o.u32((uint32_t)x);
+
+    o.fp(pk.omega_B);
+    o.u32((uint32_t)pk.powg_B.size());
+    for (const Fp & x : pk.powg_B) o.fp(x);
+
+    return write_file_atomic(path, o.b.data(), o.b.size());
+}
+
+// false on any mismatch, pk is only written on success. expect_digest,
+// when given, is the H_digest the caller trusts for this key. the digest
+// binds m, n and h_col_wt only, so expect_prm, when given, pins every
+// other params field too
+inline bool pk_cache_load(
+    const std::string & path,
+    PubKey & pk,
+    const std::array<uint8_t, 32> * expect_digest = nullptr,
+    const Params * expect_prm = nullptr
+) {
+    MappedFile mf;
+
+    if (!mf.open(path)) {
+        return false;
+    }
+
+    pkc::In in { mf.data, mf.size };
+    const uint8_t * magic = in.take(8);
+
+    if (!magic || std::memcmp(magic, "PVACPK\0\0", 8) != 0 || in.u32() != PK_CACHE_VER) {
+        return false;
+    }
+
+    PubKey k;
+
+    auto get = [&](auto & x) {
+        using T = std::remove_reference_t<decltype(x)>;
+        if constexpr (std::is_floating_point_v<T>) {
+            x = in.f64();
+        } else {
+            x = (T)(int64_t)in.u64();
+        }
+    };
+    pkc::params_io(get, k.prm);
+
+    k.canon_tag = in.u64();
+    const uint8_t * dg = in.take(32);
+
+    int m = (int)in.u32();
+    uint32_t ncols = in.u32();
+    uint32_t nrows = in.u32();
+
+    if (!in.ok || m != k.prm.m_bits || !pkc::params_ok(k.prm) ||
+        ncols != (uint32_t)k.prm.n_bits ||
+        (uint64_t)nrows != (uint64_t)ncols * (uint64_t)k.prm.h_col_wt) {
+        return false;
+    }
+
+    if (expect_prm && !pkc::params_eq(k.prm, *expect_prm)) {
+        return false;
+    }
+
+    std::memcpy(k.H_digest.data(), dg, 32);
+
+    k.H.m = m;
+    k.H.col_ptr.resize((size_t)ncols + 1);
+    k.H.rows.resize(nrows);
+
+    for (auto & x : k.H.col_ptr) x = in.u32();
+    for (auto & x : k.H.rows) x = in.u16();
+
+    if (!in.ok || k.H.col_ptr[0] != 0 || k.H.col_ptr[ncols] != nrows) {
+        return false;
+    }
+
+    // h_digest ors the rows of a column together, so a repeated row would
+    // pass it: every column holds exactly h_col_wt strictly rising rows
+    const uint32_t wt = (uint32_t)k.prm.h_col_wt;
+
+    for (uint32_t c = 0; c < ncols; c++) {
+        uint32_t a = k.H.col_ptr[c], b = k.H.col_ptr[c + 1];
+
+        if (b < a || b - a != wt || k.H.rows[b - 1] >= m) {
+            return false;
+        }
+
+        for (uint32_t i = a + 1; i < b; i++) {
+            if (k.H.rows[i] <= k.H.rows[i - 1]) {
+                return false;
+            }
+        }
+    }
+
+    k.ubk.perm.resize(m);
+    k.ubk.inv.resize(m);
+    for (auto & x : k.ubk.perm) x = (int)in.u32();
+    for (auto & x : k.ubk.inv) x = (int)in.u32();
+
+    k.omega_B = in.fp();
+    uint32_t npow = in.u32();
+
+    if (!in.ok || npow != (uint32_t)k.prm.B) {
+        return false;
+    }
+
+    k.powg_B.resize(npow);
+    for (auto & x : k.powg_B) x = in.fp();
+
+    if (!in.ok || in.left != 0) {
+        return false;
+    }
+
+    // H against its digest, and the digest against the caller's
+    std::array<uint8_t, 32> d;
+    h_digest(k.prm, k.H, d.data());
+
+    if (!ct::memeq(d.data(), k.H_digest.data(), 32)) {
+        return false;
+    }
+
+    if (expect_digest && !ct::memeq(expect_digest->data(), d.data(), 32)) {
+        return false;
+    }
+
+    // ubk is cheap to rebuild from canon_tag
+    Ubk u = gen_ubk_public(k.canon_tag, m);
+
+    if (u.perm != k.ubk.perm || u.inv != k.ubk.inv) {
+        return false;
+    }
+
+    k.ubk.net = std::move(u.net);
+
+    // powg_B = g^i for some g of order dividing B, g != 1
+    Fp one = fp_from_u64(1);
+    const auto & pw = k.powg_B;
+
+    if (!ct::fp_eq(pw[0], one) || ct::fp_eq(pw[1], one) ||
+        !ct::fp_eq(fp_mul(pw[npow - 1], pw[1]), one)) {
+        return false;
+    }
+
+    for (uint32_t i = 2; i < npow; i++) {
+        if (!ct::fp_eq(pw[i], fp_mul(pw[i - 1], pw[1]))) {
+            return false;
+        }
+    }
+
+    // keygen takes omega_B from a u64-truncated exponent, so its order is
+    // not pinned to B, only reject the degenerate values
+    if (!ct::fp_is_nonzero(k.omega_B) || ct::fp_is_one(k.omega_B)) {
+        return false;
+    }
+
+    pk = std::move(k);
+    return true;
+}
+
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include "../core/types.hpp"
+#include "lpn.hpp"
+
+namespace pvac {
+
+// opt-in memo for prf_R / prf_R_noise products, shared across dec_value,
+// layer_R_all and prf_noise_delta calls; bounded by a byte cap with
+// clock eviction, one mutex, counters readable without the lock.
+// the entries are secret-key material: keep the cache with the key
+
+enum class PrfKind : uint8_t {
+    R = 0,
+    NOISE = 1
+};
+
+struct PrfCacheKey {
+    uint64_t tag;
+    uint64_t ztag;
+    uint64_t lo;
+    uint64_t hi;
+    uint8_t kind;
+
+    bool operator==(const PrfCacheKey& o) const {
+        return tag == o.tag && ztag == o.ztag && lo == o.lo && hi == o.hi && kind == o.kind;
+    }
+};
+
+struct PrfCacheKeyHash {
+    size_t operator()(const PrfCacheKey& k) const {
+        uint64_t h = k.ztag ^ (k.lo * 0x9e3779b97f4a7c15ull) ^ (k.hi * 0xc2b2ae3d27d4eb4full);
+        h ^= (k.tag + k.kind) * 0x165667b19e3779f9ull;
+        h ^= h >> 29;
+        return (size_t)h;
+    }
+};
+
+struct PrfCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+struct PrfCache {
+    struct Slot {
+        PrfCacheKey key;
+        Fp val;
+        bool used;
+        bool ref;
+    };
+
+    // slot + hash node, roughly what one entry costs
+    static constexpr size_t ENTRY_BYTES =
+        sizeof(Slot) + sizeof(PrfCacheKey) + sizeof(size_t) + 3 * sizeof(void*);
+
+    explicit PrfCache(size_t max_bytes = (size_t)1 << 20) {
+        cap = max_bytes / ENTRY_BYTES;
+        if (cap == 0) cap = 1;
+        slots.reserve(cap);
+        map.reserve(cap);
+    }
+
+    PrfCache(const PrfCache&) = delete;
+    PrfCache& operator=(const PrfCache&) = delete;
+
+    static PrfCacheKey key_of(const PubKey& pk, const RSeed& seed, PrfKind kind) {
+        return {pk.canon_tag, seed.ztag, seed.nonce.lo, seed.nonce.hi, (uint8_t)kind};
+    }
+
+    bool get(const PrfCacheKey& k, Fp& out) {
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            auto it = map.find(k);
+            if (it != map.end()) {
+                Slot& s = slots[it->second];
+                s.ref = true;
+                out = s.val;
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void put(const PrfCacheKey& k, const Fp& v) {
+        std::lock_guard<std::mutex> lk(mu);
+
+        auto it = map.find(k);
+        if (it != map.end()) {
+            slots[it->second].val = v;
+            slots[it->second].ref = true;
+            return;
+        }
+
+        size_t at;
+        if (slots.size() < cap) {
+            at = slots.size();
+            slots.push_back({k, v, true, false});
+        } else {
+            // clock: second chance for anything touched since the last sweep
+            while (slots[hand].ref) {
+                slots[hand].ref = false;
+                hand = (hand + 1) % cap;
+            }
+            at = hand;
+            hand = (hand + 1) % cap;
+
+            map.erase(slots[at].key);
+            slots[at] = {k, v, true, false};
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        map.emplace(k, at);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lk(mu);
+        for (auto& s : slots) s.val = Fp{};
+        slots.clear();
+        map.clear();
+        hand = 0;
+    }
+
+    size_t capacity() const { return cap; }
+
+    PrfCacheStats stats() {
+        size_t n;
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            n = slots.size();
+        }
+        return {
+            hits.load(std::memory_order_relaxed),
+            misses.load(std::memory_order_relaxed),
+            evictions.load(std::memory_order_relaxed),
+            n,
+            n * ENTRY_BYTES
+        };
+    }
+
+    ~PrfCache() { clear(); }
+
+private:
+    std::mutex mu;
+    std::vector<Slot> slots;
+    std::unordered_map<PrfCacheKey, size_t, PrfCacheKeyHash> map;
+    size_t cap = 0;
+    size_t hand = 0;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+};
+
+inline Fp prf_R(const PubKey& pk, const SecKey& sk, const RSeed& seed, PrfCache* memo) {
+    if (!memo) return prf_R(pk, sk, seed);
+
+    PrfCacheKey k = PrfCache::key_of(pk, seed, PrfKind::R);
+    Fp r;
+    if (memo->get(k, r)) return r;
+    r = prf_R(pk, sk, seed);
+    memo->put(k, r);
+    return r;
+}
+
+inline Fp prf_R_noise(const PubKey& pk, const SecKey& sk, const RSeed& seed, PrfCache* memo) {
+    if (!memo) return prf_R_noise(pk, sk, seed);
+
+    PrfCacheKey k = PrfCache::key_of(pk, seed, PrfKind::NOISE);
+    Fp r;
+    if (memo->get(k, r)) return r;
+    r = prf_R_noise(pk, sk, seed);
+    memo->put(k, r);
+    return r;
+}
+
+// batch form: hits come from the memo, misses share one multi-seed pass
+inline std::vector<Fp> prf_R_batch(
+    const PubKey& pk,
+    const SecKey& sk,
+    const std::vector<RSeed>& seeds,
+    PrfCache* memo
+) {
+    if (!memo) return prf_R_batch(pk, sk, seeds);
+
+    std::vector<Fp> out(seeds.size());
+    std::vector<RSeed> miss;
+    std::vector<size_t> at;
+
+    for (size_t i = 0; i < seeds.size(); i++) {
+        if (!memo->get(PrfCache::key_of(pk, seeds[i], PrfKind::R), out[i])) {
+            miss.push_back(seeds[i]);
+            at.push_back(i);
+        }
+    }
+
+    std::vector<Fp> got = prf_R_batch(pk, sk, miss);
+    for (size_t j = 0; j < miss.size(); j++) {
+        out[at[j]] = got[j];
+        memo->put(PrfCache::key_of(pk, miss[j], PrfKind::R), got[j]);
+    }
+
+    return out;
+}
+
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <mutex>
 #include <vector>
 #include <chrono>
 #include <iostream>
@@ -190,6 +192,32 @@ inline void toep_127_clmul(
     }
 }
 
+// only bits 0..126 of the product are read and those depend on words 0..1
+// of each operand: r0 = lo(y0 t0), r1 = hi(y0 t0) ^ lo(y0 t1) ^ lo(y1 t0)
+inline void toep_127_clmul_trunc(
+    const std::vector<uint64_t> & top,
+    const std::vector<uint64_t> & ybits,
+    uint64_t & out_lo,
+    uint64_t & out_hi
+) {
+    uint64_t y0 = ybits.size() > 0 ? ybits[0] : 0;
+    uint64_t y1 = ybits.size() > 1 ? ybits[1] : 0;
+    uint64_t t0 = top.size() > 0 ? top[0] : 0;
+    uint64_t t1 = top.size() > 1 ? top[1] : 0;
+
+    __m128i vy = _mm_set_epi64x((long long)y1, (long long)y0);
+    __m128i vt = _mm_set_epi64x((long long)t1, (long long)t0);
+
+    __m128i p00 = _mm_clmulepi64_si128(vy, vt, 0x00);
+    __m128i p01 = _mm_clmulepi64_si128(vy, vt, 0x10);
+    __m128i p10 = _mm_clmulepi64_si128(vy, vt, 0x01);
+
+    __m128i mid = _mm_xor_si128(p01, p10);
+    __m128i r = _mm_xor_si128(p00, _mm_slli_si128(mid, 8));
+
+    out_lo = (uint64_t)_mm_cvtsi128_si64(r);
+    out_hi = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(r, 8)) & 0x7FFFFFFFFFFFFFFFull;
+}
 
 #endif
 
@@ -235,8 +263,10 @@ using toep_fn = void (*)(
     uint64_t &
 );
 
-inline toep_fn g_toep    = nullptr;
-inline int g_toep_id = 0;
+// picked once per process; prf workers can hit the first call together
+inline std::atomic<toep_fn> g_toep{nullptr};
+inline std::atomic<int>     g_toep_id{0};
+inline std::once_flag       g_toep_once;
 
 inline void select_toeplitz() {
     std::vector<toep_fn> cands;
@@ -245,6 +275,9 @@ inline void select_toeplitz() {
 #if defined(__PCLMUL__)
     cands.push_back(&toep_127_clmul);
     ids.push_back(1);
+
+    cands.push_back(&toep_127_clmul_trunc);
+    ids.push_back(4);
 #endif
 
 #if defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
@@ -297,13 +330,15 @@ inline void select_toeplitz() {
         }
     }
 
-    g_toep    = bestfn;
-    g_toep_id = bestid;
+    g_toep_id.store(bestid, std::memory_order_relaxed);
+    g_toep.store(bestfn, std::memory_order_release);
 
     if (g_dbg) {
-        if (g_toep_id == 1) {
+        if (bestid == 1) {
             std::cout << "impl = pclmul t_us = " << best << "\n";
-        } else if (g_toep_id == 2) {
+        } else if (bestid == 4) {
+            std::cout << "impl = pclmul-trunc t_us = " << best << "\n";
+        } else if (bestid == 2) {
             std::cout << "impl = pmull t_us = " << best << "\n";
         } else {
             std::cout << "impl = scalar t_us = " << best << "\n";
@@ -317,11 +352,13 @@ inline void toep_127(
     uint64_t & out_lo,
     uint64_t & out_hi
 ) {
-    if (!g_toep) {
-        select_toeplitz();
+    toep_fn fn = g_toep.load(std::memory_order_acquire);
+    if (!fn) {
+        std::call_once(g_toep_once, select_toeplitz);
+        fn = g_toep.load(std::memory_order_acquire);
     }
 
-    g_toep(top, ybits, out_lo, out_hi);
+    fn(top, ybits, out_lo, out_hi);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../core/types.hpp"
+#include "../core/mapped_file.hpp"
+#include "../crypto/matrix.hpp"
+#include "../crypto/pk_cache.hpp"
+#include "../ops/encrypt.hpp"
+#include "../ops/decrypt.hpp"
+#include "../ops/commit.hpp"
+
+namespace pvac {
+
+// binary ciphertext file, all integers le, every section 8 byte aligned:
+//   "PVACCT\0\0" | u32 ver | u32 m_bits | u32 B | u32 0 | u64 count | u64 sig_off
+//   | dir[count] { u64 layer_off, u64 edge_off, u32 nL, u32 nE }
+//   | per cipher: Layer[nL] | CtEdge[nE], 40 bytes each
+//   | sigma words at sig_off, (m_bits + 63) / 64 per kept sigma
+// layers are stored in their in-memory layout, so a mapped file is read
+// in place on le hosts. lazy edges (salted, no sigma) cost 40 bytes
+
+inline constexpr uint32_t CT_FILE_VER = 1;
+
+enum CtEdgeFlag : uint8_t {
+    CT_EDGE_SALTED = 1,
+    CT_EDGE_SIGMA = 2
+};
+
+struct CtEdge {
+    uint32_t layer_id;
+    uint16_t idx;
+    uint8_t ch;
+    uint8_t flags;
+    uint64_t salt;
+    Fp w;
+    uint64_t sig;   // first word in the sigma area, with CT_EDGE_SIGMA
+};
+
+static_assert(sizeof(Layer) == 40 && offsetof(Layer, seed) == 8 && offsetof(Layer, pa) == 32,
+    "ct file layer record");
+static_assert(sizeof(CtEdge) == 40 && offsetof(CtEdge, salt) == 8 && offsetof(CtEdge, w) == 16,
+    "ct file edge record");
+
+template <class T>
+struct Span {
+    const T * p = nullptr;
+    size_t n = 0;
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    const T & operator[](size_t i) const { return p[i]; }
+    const T * begin() const { return p; }
+    const T * end() const { return p + n; }
+};
+
+// one cipher inside a mapped CtFile, valid while the file stays open.
+// dec_value / dec_values / commit_ct / ct_add take it as is
+struct CipherView {
+    Span<Layer> L;
+    Span<CtEdge> E;
+    const uint64_t * sig = nullptr;
+    uint32_t m_bits = 0;
+
+    // f(words, nbits) on the sigma of e, mapped or rebuilt from its salt
+    template <class F>
+    void with_sigma(const PubKey & pk, const CtEdge & e, F && f) const {
+        if (e.flags & CT_EDGE_SIGMA) {
+            f(sig + e.sig, (size_t)m_bits);
+        } else {
+            const RSeed & sd = L[e.layer_id].seed;
+            BitVec s = sigma_from_H(pk, sd.ztag, sd.nonce, e.idx, e.ch, e.salt);
+            f(s.w.data(), s.nbits);
+        }
+    }
+};
+
+namespace ctf {
+
+inline bool fits(uint64_t off, uint64_t cnt, uint64_t rec, uint64_t size) {
+    return off <= size && off % 8 == 0 && cnt <= (size - off) / rec;
+}
+
+inline void put_layer(pkc::Out & o, const Layer & L) {
+    uint8_t r[8] = { (uint8_t)L.rule };
+    o.raw(r, 8);
+    o.u64(L.seed.ztag);
+    o.u64(L.seed.nonce.lo);
+    o.u64(L.seed.nonce.hi);
+    o.u32(L.pa);
+    o.u32(L.pb);
+}
+
+// edge record, a kept sigma goes onto the end of sig
+inline bool put_edge(pkc::Out & o, const PubKey & pk, const Edge & e, std::vector<uint64_t> & sig) {
+    bool kept = e.s.nbits != 0;
+
+    if ((kept && (e.s.nbits != (size_t)pk.prm.m_bits || e.s.w.size() != ((size_t)pk.prm.m_bits + 63) / 64)) ||
+        (!kept && !e.salted)) {
+        return false;
+    }
+
+    o.u32(e.layer_id);
+    o.u16(e.idx);
+
+    uint8_t cf[2] = { e.ch, (uint8_t)((e.salted ? CT_EDGE_SALTED : 0) | (kept ? CT_EDGE_SIGMA : 0)) };
+    o.raw(cf, 2);
+
+    o.u64(e.salt);
+    o.fp(e.w);
+    o.u64(kept ? sig.size() : 0);
+
+    if (kept) {
+        sig.insert(sig.end(), e.s.w.begin(), e.s.w.end());
+    }
+
+    return true;
+}
+
+// rules, parents, edge fields and sigma references of v against B and
+// the nsig words of its sigma area
+inline bool check(const CipherView & v, uint32_t B, uint64_t nsig) {
+    const uint64_t nL = v.L.size();
+    const uint64_t wpe = ((uint64_t)v.m_bits + 63) / 64;
+
+    for (const auto & L : v.L) {
+        uint8_t r = (uint8_t)L.rule;
+
+        if (r > 1 || (L.rule == RRule::PROD && (L.pa >= nL || L.pb >= nL))) {
+            return false;
+        }
+    }
+
+    // a PROD cycle would abort the first decryption, so refuse it here
+    std::vector<uint32_t> order;
+    if (!layer_topo_try(v, order)) {
+        return false;
+    }
+
+    for (const auto & e : v.E) {
+        bool kept = e.flags & CT_EDGE_SIGMA;
+
+        if (e.layer_id >= nL || e.idx >= B || e.ch > SGN_M ||
+            e.flags > (CT_EDGE_SALTED | CT_EDGE_SIGMA) ||
+            (!kept && !(e.flags & CT_EDGE_SALTED)) ||
+            (kept && (e.sig > nsig || wpe > nsig - e.sig))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+// false when an edge has a sigma of the wrong size, or neither a sigma
+// nor a salt to rebuild it from
+inline bool ct_file_save(const std::string & path, const PubKey & pk, const Cipher * cs, size_t n) {
+    pkc::Out o;
+    o.raw("PVACCT\0\0", 8);
+    o.u32(CT_FILE_VER);
+    o.u32((uint32_t)pk.prm.m_bits);
+    o.u32((uint32_t)pk.prm.B);
+    o.u32(0);
+    o.u64(n);
+
+    uint64_t off = 40 + 24 * (uint64_t)n;
+    std::vector<uint64_t> dir;
+
+    for (size_t ci = 0; ci < n; ci++) {
+        dir.push_back(off);
+        dir.push_back(off + 40 * (uint64_t)cs[ci].L.size());
+        off += 40 * (uint64_t)(cs[ci].L.size() + cs[ci].E.size());
+    }
+
+    o.u64(off);
+
+    for (size_t ci = 0; ci < n; ci++) {
+        o.u64(dir[2 * ci]);
+        o.u64(dir[2 * ci + 1]);
+        o.u32((uint32_t)cs[ci].L.size());
+        o.u32((uint32_t)cs[ci].E.size());
+    }
+
+    std::vector<uint64_t> sig;
+
+    for (size_t ci = 0; ci < n; ci++) {
+        for (const auto & L : cs[ci].L) {
+            ctf::put_layer(o, L);
+        }
+
+        for (const auto & e : cs[ci].E) {
+            if (!ctf::put_edge(o, pk, e, sig)) {
+                return false;
+            }
+        }
+    }
+
+    for (uint64_t x : sig) o.u64(x);
+
+    return write_file_atomic(path, o.b.data(), o.b.size());
+}
+
+inline bool ct_file_save(const std::string & path, const PubKey & pk, const std::vector<Cipher> & cs) {
+    return ct_file_save(path, pk, cs.data(), cs.size());
+}
+
+// a mapped ciphertext file. open checks every offset, parent, edge index
+// and sigma reference up front, so the views need no checks afterwards
+struct CtFile {
+    MappedFile mf;
+    std::vector<CipherView> cts;
+
+    bool open(const std::string & path, const PubKey & pk) {
+        cts.clear();
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+        (void)path;
+        (void)pk;
+        return false;
+#else
+        if (!mf.open(path)) {
+            return false;
+        }
+
+        pkc::In in { mf.data, mf.size };
+        const uint8_t * magic = in.take(8);
+
+        if (!magic || std::memcmp(magic, "PVACCT\0\0", 8) != 0 || in.u32() != CT_FILE_VER) {
+            return fail();
+        }
+
+        uint32_t m_bits = in.u32();
+        uint32_t B = in.u32();
+        in.u32();
+        uint64_t n = in.u64();
+        uint64_t sig_off = in.u64();
+
+        if (!in.ok || m_bits != (uint32_t)pk.prm.m_bits || B != (uint32_t)pk.prm.B ||
+            !ctf::fits(40, n, 24, mf.size) || !ctf::fits(sig_off, 0, 8, mf.size)) {
+            return fail();
+        }
+
+        const uint64_t nsig = (mf.size - sig_off) / 8;
+        const uint64_t * sig = (const uint64_t *)(mf.data + sig_off);
+
+        if ((mf.size - sig_off) % 8 != 0) {
+            return fail();
+        }
+
+        cts.resize(n);
+
+        for (auto & v : cts) {
+            uint64_t loff = in.u64();
+            uint64_t eoff = in.u64();
+            uint32_t nL = in.u32();
+            uint32_t nE = in.u32();
+
+            if (!ctf::fits(loff, nL, 40, sig_off) || !ctf::fits(eoff, nE, 40, sig_off)) {
+                return fail();
+            }
+
+            v.L = { (const Layer *)(mf.data + loff), nL };
+            v.E = { (const CtEdge *)(mf.data + eoff), nE };
+            v.sig = sig;
+            v.m_bits = m_bits;
+
+            if (!ctf::check(v, B, nsig)) {
+                return fail();
+            }
+        }
+
+        return true;
+#endif
+    }
+
+    size_t size() const {
+        return cts.size();
+    }
+
+    const CipherView & operator[](size_t i) const {
+        return cts[i];
+    }
+
+private:
+    bool fail() {
+        cts.clear();
+        mf.close();
+        return false;
+    }
+};
+
+// copy the layers and edges of v onto the end of C, layer ids shifted
+inline void ct_append(Cipher & C, const CipherView & v) {
+    uint32_t off = (uint32_t)C.L.size();
+    size_t wpe = ((size_t)v.m_bits + 63) / 64;
+
+    for (Layer L : v.L) {
+        if (L.rule == RRule::PROD) { L.pa += off; L.pb += off; }
+        C.L.push_back(L);
+    }
+
+    for (const auto & r : v.E) {
+        Edge e { r.layer_id + off, r.idx, r.ch, r.w, BitVec {}, r.salt, (r.flags & CT_EDGE_SALTED) != 0 };
+
+        if (r.flags & CT_EDGE_SIGMA) {
+            e.s.nbits = v.m_bits;
+            e.s.w.assign(v.sig + r.sig, v.sig + r.sig + wpe);
+        }
+
+        C.E.push_back(std::move(e));
+    }
+}
+
+inline Cipher ct_load(const CipherView & v) {
+    Cipher C;
+    C.L.reserve(v.L.size());
+    C.E.reserve(v.E.size());
+    ct_append(C, v);
+    return C;
+}
+
+inline Cipher ct_add(const PubKey & pk, const CipherView & A, const CipherView & B) {
+    Cipher C;
+    C.L.reserve(A.L.size() + B.L.size());
+    C.E.reserve(A.E.size() + B.E.size());
+    ct_append(C, A);
+    ct_append(C, B);
+
+    guard_budget(pk, C, "add");
+    compact_layers(C);
+    return C;
+}
+
+inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const CipherView & C) {
+    return commit_edges(pk, C, [&](const CtEdge & e, auto && f) {
+        C.with_sigma(pk, e, f);
+    });
+}
+
+}
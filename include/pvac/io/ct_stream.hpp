@@ -0,0 +1,408 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <future>
+
+#include "../core/types.hpp"
+#include "../core/hash.hpp"
+#include "../core/parallel.hpp"
+#include "ct_file.hpp"
+
+namespace pvac {
+
+// append-only ciphertext archive, all integers le:
+//   "PVACAR\0\0" | u32 ver | u32 m_bits | u32 B | u32 0
+//   | record* { u32 len | u32 crc32c(payload) | payload[len] }
+//   | u64 off[n] | u64 n | "PVACIDX\0"
+// payload = u32 nL | u32 nE | Layer[nL] | CtEdge[nE] | sigma words, the
+// same records as a CtFile with sig counted from the payload's own sigma
+// words. len is a multiple of 8, so a payload read into a u64 buffer is
+// viewed in place. the footer indexes record offsets for random access
+
+inline constexpr uint32_t CT_ARCHIVE_VER = 1;
+
+namespace ctf {
+
+inline constexpr uint32_t MAX_RECORD = 1u << 31;
+
+// payload of one record, false as for ct_file_save
+inline bool put_record(pkc::Out & o, const PubKey & pk, const Cipher & C) {
+    std::vector<uint64_t> sig;
+
+    o.u32((uint32_t)C.L.size());
+    o.u32((uint32_t)C.E.size());
+
+    for (const auto & L : C.L) {
+        put_layer(o, L);
+    }
+
+    for (const auto & e : C.E) {
+        if (!put_edge(o, pk, e, sig)) {
+            return false;
+        }
+    }
+
+    for (uint64_t x : sig) o.u64(x);
+    return true;
+}
+
+// view of a payload at p (8 byte aligned), false on a malformed record
+inline bool view_record(const uint8_t * p, size_t len, uint32_t m_bits, uint32_t B, CipherView & v) {
+    pkc::In in { p, len };
+    uint32_t nL = in.u32();
+    uint32_t nE = in.u32();
+
+    if (!in.ok || !fits(8, (uint64_t)nL + nE, 40, len)) {
+        return false;
+    }
+
+    uint64_t sig_off = 8 + 40 * ((uint64_t)nL + nE);
+
+    if ((len - sig_off) % 8 != 0) {
+        return false;
+    }
+
+    v.L = { (const Layer *)(p + 8), nL };
+    v.E = { (const CtEdge *)(p + 8 + 40 * (uint64_t)nL), nE };
+    v.sig = (const uint64_t *)(p + sig_off);
+    v.m_bits = m_bits;
+
+    return check(v, B, (len - sig_off) / 8);
+}
+
+}
+
+struct CtArchiveWriter {
+    std::ofstream f;
+    std::vector<uint64_t> index;
+    uint64_t pos = 0;
+    const PubKey * pk = nullptr;
+
+    // an archive left open gets its footer here, so an early return
+    // still leaves the records written so far readable
+    ~CtArchiveWriter() {
+        if (f.is_open()) {
+            close();
+        }
+    }
+
+    bool open(const std::string & path, const PubKey & key) {
+        f.close();
+        f.clear();
+        f.open(path, std::ios::binary | std::ios::trunc);
+        index.clear();
+        pos = 0;
+        pk = &key;
+
+        pkc::Out o;
+        o.raw("PVACAR\0\0", 8);
+        o.u32(CT_ARCHIVE_VER);
+        o.u32((uint32_t)key.prm.m_bits);
+        o.u32((uint32_t)key.prm.B);
+        o.u32(0);
+
+        return write(o);
+    }
+
+    bool put(const Cipher & C) {
+        pkc::Out o;
+        o.u64(0);
+
+        if (!pk || !ctf::put_record(o, *pk, C) || o.b.size() - 8 >= ctf::MAX_RECORD) {
+            return false;
+        }
+
+        uint32_t len = (uint32_t)(o.b.size() - 8);
+        uint32_t crc = crc32c(o.b.data() + 8, len);
+
+        for (int i = 0; i < 4; i++) {
+            o.b[i] = (uint8_t)(len >> (8 * i));
+            o.b[4 + i] = (uint8_t)(crc >> (8 * i));
+        }
+
+        index.push_back(pos);
+        return write(o);
+    }
+
+    // writes the index footer, the archive is unreadable without it
+    bool close() {
+        pkc::Out o;
+        for (uint64_t x : index) o.u64(x);
+        o.u64(index.size());
+        o.raw("PVACIDX\0", 8);
+
+        bool ok = write(o);
+        f.close();
+        pk = nullptr;
+        return ok && !f.fail();
+    }
+
+private:
+    bool write(const pkc::Out & o) {
+        f.write((const char *)o.b.data(), (std::streamsize)o.b.size());
+        pos += o.b.size();
+        return (bool)f;
+    }
+};
+
+// whole records read in one go, views point into buf
+struct CtChunk {
+    std::vector<uint64_t> buf;
+    std::vector<CipherView> cts;
+    size_t first = 0;   // archive index of cts[0]
+};
+
+// reads records in chunks of about chunk_bytes, the next chunk is read
+// by a background task while the caller works on the current one, so at
+// most two chunks are held
+struct CtArchiveReader {
+    uint32_t m_bits = 0;
+    uint32_t B = 0;
+    std::vector<uint64_t> index;
+    uint64_t data_end = 0;
+    size_t chunk_bytes = 64u << 20;
+    bool bad = false;
+
+    ~CtArchiveReader() {
+        if (ahead.valid()) {
+            ahead.wait();
+        }
+    }
+
+    bool open(const std::string & path, const PubKey & pk) {
+        if (ahead.valid()) {
+            ahead.wait();
+        }
+
+        seq.close();
+        ra.close();
+        seq.open(path, std::ios::binary);
+        ra.open(path, std::ios::binary);
+        index.clear();
+        next_rec = 0;
+        bad = false;
+
+        uint8_t h[24];
+
+        if (!seq || !seq.read((char *)h, 24) || std::memcmp(h, "PVACAR\0\0", 8) != 0) {
+            return fail();
+        }
+
+        pkc::In in { h + 8, 16 };
+        uint32_t ver = in.u32();
+        m_bits = in.u32();
+        B = in.u32();
+        uint32_t reserved = in.u32();
+
+        if (ver != CT_ARCHIVE_VER || reserved != 0 || m_bits != (uint32_t)pk.prm.m_bits || B != (uint32_t)pk.prm.B) {
+            return fail();
+        }
+
+        // footer: u64 n | magic, then n offsets in front of it
+        seq.seekg(0, std::ios::end);
+        uint64_t size = (uint64_t)seq.tellg();
+        uint8_t t[16];
+
+        if (size < 40 || !seq.seekg((std::streamoff)(size - 16)) || !seq.read((char *)t, 16) ||
+            std::memcmp(t + 8, "PVACIDX\0", 8) != 0) {
+            return fail();
+        }
+
+        uint64_t n = load_le64(t);
+
+        if (n > (size - 40) / 8) {
+            return fail();
+        }
+
+        data_end = size - 16 - 8 * n;
+        std::vector<uint8_t> raw(8 * n);
+
+        if (!seq.seekg((std::streamoff)data_end) || !seq.read((char *)raw.data(), (std::streamsize)raw.size())) {
+            return fail();
+        }
+
+        index.resize(n);
+        for (uint64_t i = 0; i < n; i++) {
+            index[i] = load_le64(raw.data() + 8 * i);
+
+            if (index[i] < 24 || index[i] + 8 > data_end || (i && index[i] <= index[i - 1])) {
+                return fail();
+            }
+        }
+
+        return true;
+    }
+
+    size_t size() const {
+        return index.size();
+    }
+
+    // next chunk in file order, false at the end or on a bad record (bad
+    // is set then). c is overwritten, views from before are invalidated
+    bool next(CtChunk & c) {
+        if (!ahead.valid()) {
+            ahead = read_ahead(std::move(spare));
+        }
+
+        CtChunk got = ahead.get();
+
+        if (got.cts.empty()) {
+            spare = std::move(got);
+            return false;
+        }
+
+        spare = std::move(c);
+        c = std::move(got);
+
+        if (next_rec < index.size()) {
+            ahead = read_ahead(std::move(spare));
+        }
+
+        return true;
+    }
+
+    // record i alone, through a second stream so it does not disturb next
+    bool get(size_t i, Cipher & out) {
+        CtChunk c;
+
+        if (i >= index.size() || !read_record(ra, index[i], c) || !make_views(c, { 0 })) {
+            return false;
+        }
+
+        out = ct_load(c.cts[0]);
+        return true;
+    }
+
+private:
+    std::ifstream seq;
+    std::ifstream ra;
+    size_t next_rec = 0;
+    std::future<CtChunk> ahead;
+    CtChunk spare;
+
+    bool fail() {
+        seq.close();
+        ra.close();
+        index.clear();
+        return false;
+    }
+
+    // payload of the record at off appended to c.buf
+    bool read_record(std::ifstream & f, uint64_t off, CtChunk & c) {
+        uint8_t h[8];
+
+        f.clear();
+
+        if (!f.seekg((std::streamoff)off) || !f.read((char *)h, 8)) {
+            return false;
+        }
+
+        uint32_t len = (uint32_t)load_le64(h);
+        uint32_t crc = (uint32_t)(load_le64(h) >> 32);
+
+        if (len % 8 != 0 || len < 8 || len > data_end - off - 8) {
+            return false;
+        }
+
+        size_t at = c.buf.size();
+        c.buf.resize(at + len / 8);
+
+        if (!f.read((char *)(c.buf.data() + at), len) ||
+            crc32c((const uint8_t *)(c.buf.data() + at), len) != crc) {
+            return false;
+        }
+
+        return true;
+    }
+
+    // views over the payloads starting at words at[k] of c.buf, once buf
+    // has stopped growing
+    bool make_views(CtChunk & c, const std::vector<size_t> & at) {
+        const uint8_t * base = (const uint8_t *)c.buf.data();
+        c.cts.resize(at.size());
+
+        for (size_t k = 0; k < at.size(); k++) {
+            size_t end = k + 1 < at.size() ? at[k + 1] : c.buf.size();
+
+            if (!ctf::view_record(base + 8 * at[k], 8 * (end - at[k]), m_bits, B, c.cts[k])) {
+                c.cts.clear();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // whole records up to chunk_bytes (at least one), runs on the
+    // background task, the only user of seq after open
+    std::future<CtChunk> read_ahead(CtChunk c) {
+        size_t lo = next_rec;
+        size_t hi = lo;
+        uint64_t bytes = 0;
+
+        while (hi < index.size() && (hi == lo || bytes < chunk_bytes)) {
+            uint64_t end = hi + 1 < index.size() ? index[hi + 1] : data_end;
+            bytes += end - index[hi];
+            hi++;
+        }
+
+        next_rec = hi;
+
+        return std::async(std::launch::async, [this, lo, hi, c = std::move(c)]() mutable {
+            c.buf.clear();
+            c.cts.clear();
+            c.first = lo;
+
+            std::vector<size_t> at;
+
+            for (size_t i = lo; i < hi; i++) {
+                at.push_back(c.buf.size());
+
+                if (!read_record(seq, index[i], c)) {
+                    bad = true;
+                    c.cts.clear();
+                    return std::move(c);
+                }
+            }
+
+            if (!make_views(c, at)) {
+                bad = true;
+            }
+
+            // moved, not copied: the views point into this buf
+            return std::move(c);
+        });
+    }
+};
+
+// f(i, view) on every record of the archive, records of a chunk spread
+// over the workers while the next chunk is read. false on an unreadable
+// archive or a bad record
+template <class F>
+inline bool ct_archive_scan(const std::string & path, const PubKey & pk, F && f, size_t chunk_bytes = 64u << 20) {
+    CtArchiveReader rd;
+    rd.chunk_bytes = chunk_bytes;
+
+    if (!rd.open(path, pk)) {
+        return false;
+    }
+
+    CtChunk c;
+
+    while (rd.next(c)) {
+        parallel_for(c.cts.size(), 1, [&](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; i++) {
+                f(c.first + i, c.cts[i]);
+            }
+        });
+    }
+
+    return !rd.bad;
+}
+
+}
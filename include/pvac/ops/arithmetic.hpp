@@ -2,9 +2,11 @@
 
 #include <cstdint>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
 
 #include "../core/types.hpp"
+#include "../core/parallel.hpp"
 #include "encrypt.hpp"
 
 namespace pvac {
@@ -30,18 +32,186 @@ inline Cipher ct_add(const PubKey& pk, const Cipher& A, const Cipher& B) {
     return C;
 }
 
-inline Cipher ct_scale(const PubKey&, const Cipher& A, const Fp& s) {
+// b's live layers appended to acc.L, returns where each layer of b
+// landed (UINT32_MAX for dead ones). a Cipher or a CipherSoA on either side
+template <class A, class B>
+inline std::vector<uint32_t> ct_append_layers(A& acc, const B& b) {
+    std::vector<uint8_t> used = layer_live(b);
+    std::vector<uint32_t> remap(b.L.size(), UINT32_MAX);
+
+    uint32_t next = (uint32_t)acc.L.size();
+    for (size_t lid = 0; lid < b.L.size(); ++lid) if (used[lid]) remap[lid] = next++;
+
+    for (size_t lid = 0; lid < b.L.size(); ++lid) {
+        if (!used[lid]) continue;
+        Layer L = b.L[lid];
+        if (L.rule == RRule::PROD) { L.pa = remap[L.pa]; L.pb = remap[L.pb]; }
+        acc.L.push_back(L);
+    }
+    return remap;
+}
+
+// acc += b (acc -= b with neg) in place, costs only the edges of b: its
+// edges are copied, or moved out when b is an rvalue. the layers already
+// in acc are neither copied nor compacted
+template <class CT>
+inline void ct_accumulate(const PubKey& pk, Cipher& acc, CT&& b, bool neg) {
+    if ((const void*)&acc == (const void*)&b) {
+        ct_accumulate(pk, acc, Cipher(b), neg);
+        return;
+    }
+
+    std::vector<uint32_t> remap = ct_append_layers(acc, b);
+
+    for (auto& e : b.E) {
+        if constexpr (std::is_lvalue_reference_v<CT>) acc.E.push_back(e);
+        else acc.E.push_back(std::move(e));
+
+        Edge& x = acc.E.back();
+        x.layer_id = remap[x.layer_id];
+        if (neg) x.w = fp_neg(x.w);
+    }
+
+    if constexpr (!std::is_lvalue_reference_v<CT>) b.E.clear();
+
+    guard_budget(pk, acc, neg ? "sub" : "add");
+}
+
+inline void ct_add_inplace(const PubKey& pk, Cipher& acc, const Cipher& b) {
+    ct_accumulate(pk, acc, b, false);
+}
+
+inline void ct_add_inplace(const PubKey& pk, Cipher& acc, Cipher&& b) {
+    ct_accumulate(pk, acc, std::move(b), false);
+}
+
+inline void ct_sub_inplace(const PubKey& pk, Cipher& acc, const Cipher& b) {
+    ct_accumulate(pk, acc, b, true);
+}
+
+inline void ct_sub_inplace(const PubKey& pk, Cipher& acc, Cipher&& b) {
+    ct_accumulate(pk, acc, std::move(b), true);
+}
+
+inline void ct_scale_inplace(const PubKey&, Cipher& A, const Fp& s) {
+    for (auto& e : A.E) e.w = fp_mul(e.w, s);
+}
+
+// rvalue operands are reused instead of copied, the layers of A are then
+// kept as they are
+inline Cipher ct_add(const PubKey& pk, Cipher&& A, const Cipher& B) {
+    ct_add_inplace(pk, A, B);
+    return std::move(A);
+}
+
+inline Cipher ct_add(const PubKey& pk, Cipher&& A, Cipher&& B) {
+    ct_add_inplace(pk, A, std::move(B));
+    return std::move(A);
+}
+
+inline Cipher ct_add(const PubKey& pk, const Cipher& A, Cipher&& B) {
+    Cipher C = A;
+    ct_add_inplace(pk, C, std::move(B));
+    return C;
+}
+
+inline Cipher ct_scale(const PubKey& pk, const Cipher& A, const Fp& s) {
     Cipher C = A;
-    for (auto& e : C.E) e.w = fp_mul(e.w, s);
+    ct_scale_inplace(pk, C, s);
     return C;
 }
 
+inline Cipher ct_scale(const PubKey& pk, Cipher&& A, const Fp& s) {
+    ct_scale_inplace(pk, A, s);
+    return std::move(A);
+}
+
 inline Cipher ct_neg(const PubKey& pk, const Cipher& A) {
     return ct_scale(pk, A, fp_neg(fp_from_u64(1)));
 }
 
+inline Cipher ct_neg(const PubKey& pk, Cipher&& A) {
+    return ct_scale(pk, std::move(A), fp_neg(fp_from_u64(1)));
+}
+
+// B is negated while it is appended, one copy of each operand
 inline Cipher ct_sub(const PubKey& pk, const Cipher& A, const Cipher& B) {
-    return ct_add(pk, A, ct_neg(pk, B));
+    Cipher C = A;
+    ct_sub_inplace(pk, C, B);
+    compact_layers(C);
+    return C;
+}
+
+inline Cipher ct_sub(const PubKey& pk, Cipher&& A, const Cipher& B) {
+    ct_sub_inplace(pk, A, B);
+    return std::move(A);
+}
+
+inline Cipher ct_sub(const PubKey& pk, Cipher&& A, Cipher&& B) {
+    ct_sub_inplace(pk, A, std::move(B));
+    return std::move(A);
+}
+
+inline Cipher ct_sub(const PubKey& pk, const Cipher& A, Cipher&& B) {
+    Cipher C = A;
+    ct_sub_inplace(pk, C, std::move(B));
+    return C;
+}
+
+// sum of n ciphers in one pass: the live layers of every input are found
+// in parallel, the output is sized once and each input fills its own
+// slice of it in parallel, the edge budget is checked once at the end
+inline Cipher ct_sum(const PubKey& pk, const Cipher* cs, size_t n) {
+    std::vector<std::vector<uint32_t>> remap(n);
+    std::vector<size_t> loff(n + 1, 0), eoff(n + 1, 0);
+
+    parallel_for(n, 4, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            std::vector<uint8_t> used = layer_live(cs[i]);
+            remap[i].assign(cs[i].L.size(), UINT32_MAX);
+
+            uint32_t k = 0;
+            for (size_t lid = 0; lid < used.size(); ++lid) if (used[lid]) remap[i][lid] = k++;
+            loff[i + 1] = k;
+        }
+    });
+
+    for (size_t i = 0; i < n; ++i) {
+        loff[i + 1] += loff[i];
+        eoff[i + 1] = eoff[i] + cs[i].E.size();
+    }
+
+    Cipher C;
+    C.L.resize(loff[n]);
+    C.E.resize(eoff[n]);
+
+    parallel_for(n, 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            const uint32_t base = (uint32_t)loff[i];
+            const std::vector<uint32_t>& rm = remap[i];
+
+            for (size_t lid = 0; lid < rm.size(); ++lid) {
+                if (rm[lid] == UINT32_MAX) continue;
+                Layer L = cs[i].L[lid];
+                if (L.rule == RRule::PROD) { L.pa = base + rm[L.pa]; L.pb = base + rm[L.pb]; }
+                C.L[base + rm[lid]] = L;
+            }
+
+            Edge* out = C.E.data() + eoff[i];
+            for (const auto& e : cs[i].E) {
+                *out = e;
+                out->layer_id = base + rm[e.layer_id];
+                ++out;
+            }
+        }
+    });
+
+    guard_budget(pk, C, "sum");
+    return C;
+}
+
+inline Cipher ct_sum(const PubKey& pk, const std::vector<Cipher>& cs) {
+    return ct_sum(pk, cs.data(), cs.size());
 }
 
 inline Cipher ct_mul(const PubKey& pk, const Cipher& A, const Cipher& B) {
@@ -69,37 +239,105 @@ inline Cipher ct_mul(const PubKey& pk, const Cipher& A, const Cipher& B) {
         }
     }
     
-    struct Agg { Fp wp{}, wm{}; bool ip = false, im = false; };
-    struct H { size_t operator()(uint64_t x) const noexcept { return x * 0x9E3779B97F4A7C15ull; } };
-    
-    std::unordered_map<uint64_t, Agg, H> acc;
-    acc.reserve(A.E.size() * B.E.size());
-    int Bmod = pk.prm.B;
-    
-    for (const auto& ea : A.E) {
-        for (const auto& eb : B.E) {
-            uint64_t k = ((uint64_t)(ea.layer_id * LB + eb.layer_id) << 32) | ((ea.idx + eb.idx) % Bmod);
-            Agg& a = acc[k];
-            Fp ww = fp_mul(ea.w, eb.w);
-            (ea.ch == eb.ch)
-                ? (a.ip || (a.wp = fp_from_u64(0), a.ip = true), a.wp = fp_add(a.wp, ww))
-                : (a.im || (a.wm = fp_from_u64(0), a.im = true), a.wm = fp_add(a.wm, ww));
+    // edges of each side bucketed by layer, SoA
+    struct Side {
+        std::vector<uint32_t> off;
+        std::vector<uint16_t> idx;
+        std::vector<uint8_t> ch;
+        std::vector<Fp> w;
+    };
+
+    auto bucket = [](const Cipher& X, uint32_t nl) {
+        Side S;
+        S.off.assign(nl + 1, 0);
+        for (const auto& e : X.E) S.off[e.layer_id + 1]++;
+        for (uint32_t l = 0; l < nl; ++l) S.off[l + 1] += S.off[l];
+
+        std::vector<uint32_t> pos(S.off.begin(), S.off.end() - 1);
+        S.idx.resize(X.E.size());
+        S.ch.resize(X.E.size());
+        S.w.resize(X.E.size());
+
+        for (const auto& e : X.E) {
+            uint32_t p = pos[e.layer_id]++;
+            S.idx[p] = e.idx;
+            S.ch[p] = e.ch;
+            S.w[p] = e.w;
         }
-    }
-    
-    auto emit = [&](uint32_t lid, uint16_t idx, uint8_t ch, const Fp& w) {
-        const Layer& Lp = C.L[lid];
-        C.E.push_back(Edge{lid, idx, ch, w,
-            sigma_from_H(pk, Lp.seed.ztag, Lp.seed.nonce, idx, ch, csprng_u64())});
+        return S;
     };
-    
-    for (const auto& [k, a] : acc) {
-        uint32_t lid = base + (uint32_t)(k >> 32);
-        uint16_t idx = (uint16_t)(k & 0xFFFF);
-        if (a.ip && ct::fp_is_nonzero(a.wp)) emit(lid, idx, SGN_P, a.wp);
-        if (a.im && ct::fp_is_nonzero(a.wm)) emit(lid, idx, SGN_M, a.wm);
-    }
-    
+
+    Side SA = bucket(A, LA), SB = bucket(B, LB);
+    int Bmod = pk.prm.B;
+
+    // pass 1, sharded by layer pair: both sign sums for a pair's B
+    // exponents fit in L1, survivors go to that pair's term list
+    struct Term { uint16_t idx; uint8_t ch; Fp w; };
+    size_t npair = (size_t)LA * LB;
+    std::vector<std::vector<Term>> terms(npair);
+
+    parallel_for(npair, 8, [&](size_t lo, size_t hi) {
+        std::vector<Fp> wp(Bmod), wm(Bmod);
+        Fp zero = fp_from_u64(0);
+
+        for (size_t pr = lo; pr < hi; ++pr) {
+            uint32_t la = (uint32_t)(pr / LB), lb = (uint32_t)(pr % LB);
+            uint32_t a0 = SA.off[la], a1 = SA.off[la + 1];
+            uint32_t b0 = SB.off[lb], b1 = SB.off[lb + 1];
+            if (a0 == a1 || b0 == b1) continue;
+
+            std::fill(wp.begin(), wp.end(), zero);
+            std::fill(wm.begin(), wm.end(), zero);
+
+            for (uint32_t i = a0; i < a1; ++i) {
+                int ia = SA.idx[i];
+                uint8_t ca = SA.ch[i];
+                Fp wa = SA.w[i];
+
+                for (uint32_t j = b0; j < b1; ++j) {
+                    int k = ia + SB.idx[j];
+                    if (k >= Bmod) k -= Bmod;
+                    Fp ww = fp_mul(wa, SB.w[j]);
+                    Fp& t = (ca == SB.ch[j]) ? wp[k] : wm[k];
+                    t = fp_add(t, ww);
+                }
+            }
+
+            auto& out = terms[pr];
+            for (int k = 0; k < Bmod; ++k) {
+                if (ct::fp_is_nonzero(wp[k])) out.push_back({(uint16_t)k, SGN_P, wp[k]});
+                if (ct::fp_is_nonzero(wm[k])) out.push_back({(uint16_t)k, SGN_M, wm[k]});
+            }
+        }
+    });
+
+    // pass 2, serial: edge slots in pair order, salts drawn in that
+    // order from this thread's csprng so the result is thread-count free
+    std::vector<size_t> first(npair + 1, 0);
+    for (size_t pr = 0; pr < npair; ++pr) first[pr + 1] = first[pr] + terms[pr].size();
+
+    size_t ne = first[npair];
+    std::vector<uint64_t> salt(ne);
+    csprng_fill_u64(salt.data(), ne);
+    C.E.resize(ne);
+
+    // pass 3, sharded by edge: one sigma_from_H per output edge, none
+    // with lazy_sigma
+    parallel_for(ne, 16, [&](size_t lo, size_t hi) {
+        size_t pr = (size_t)(std::upper_bound(first.begin(), first.end(), lo) - first.begin()) - 1;
+
+        for (size_t i = lo; i < hi; ++i) {
+            while (first[pr + 1] <= i) ++pr;
+
+            uint32_t lid = base + (uint32_t)pr;
+            const Layer& Lp = C.L[lid];
+            const Term& x = terms[pr][i - first[pr]];
+            BitVec s = pk.prm.lazy_sigma ? BitVec{}
+                : sigma_from_H(pk, Lp.seed.ztag, Lp.seed.nonce, x.idx, x.ch, salt[i]);
+            C.E[i] = Edge{lid, x.idx, x.ch, x.w, std::move(s), salt[i], true};
+        }
+    });
+
     guard_budget(pk, C, "mul");
     compact_layers(C);
     return C;
@@ -6,10 +6,14 @@
 
 #include "../core/types.hpp"
 #include "../core/hash.hpp"
+#include "../crypto/matrix.hpp"
 
 namespace pvac {
 
-inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C) 
+// sig(e, f) calls f(words, nbits) on the sigma of edge e, lets the same
+// hash run over a Cipher and over a mapped CipherView
+template <class CT, class Sig>
+inline std::array<uint8_t, 32> commit_edges(const PubKey & pk, const CT & C, Sig && sig)
 {
     Sha256 s;
     s.init();
@@ -57,27 +61,29 @@ inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C)
 
         s.update(w16, 16);
 
-        size_t bytes = (e.s.nbits + 7) / 8;
-        size_t full  = bytes / 8;
-        size_t rem   = bytes % 8;
+        sig(e, [&](const uint64_t * sw, size_t nbits) {
+            size_t bytes = (nbits + 7) / 8;
+            size_t full  = bytes / 8;
+            size_t rem   = bytes % 8;
 
-        for (size_t i = 0; i < full; i++) {
-            uint8_t b[8];
-            store_le64(b, e.s.w[i]);
-            s.update(b, 8);
-        }
+            for (size_t i = 0; i < full; i++) {
+                uint8_t b[8];
+                store_le64(b, sw[i]);
+                s.update(b, 8);
+            }
 
-        if (rem) {
-            uint8_t b[8];
+            if (rem) {
+                uint8_t b[8];
 
-            uint64_t x = e.s.w[full];
+                uint64_t x = sw[full];
 
-            for (size_t j = 0; j < rem; j++) {
-                b[j] = (uint8_t)((x >> (8 * j)) & 0xFF);
-            }
+                for (size_t j = 0; j < rem; j++) {
+                    b[j] = (uint8_t)((x >> (8 * j)) & 0xFF);
+                }
 
-            s.update(b, rem);
-        }
+                s.update(b, rem);
+            }
+        });
     }
 
     std::array<uint8_t, 32> out {};
@@ -86,6 +92,19 @@ inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C)
     return out;
 }
 
+// lazy sigmas are rebuilt, so the commitment is the same either way
+inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C)
+{
+    return commit_edges(pk, C, [&](const Edge & e, auto && f) {
+        if (edge_sigma_lazy(e)) {
+            BitVec s = edge_sigma(pk, C, e);
+            f(s.w.data(), s.nbits);
+        } else {
+            f(e.s.w.data(), e.s.nbits);
+        }
+    });
+}
+
 
 
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <utility>
+#include <vector>
+
+#include "../core/types.hpp"
+#include "../core/bitvec.hpp"
+#include "../core/parallel.hpp"
+#include "../crypto/matrix.hpp"
+#include "encrypt.hpp"
+#include "arithmetic.hpp"
+#include "commit.hpp"
+
+namespace pvac {
+
+// edge i of a CipherSoA read out of its columns
+struct EdgeRef {
+    uint32_t layer_id;
+    uint16_t idx;
+    uint8_t ch;
+    Fp w;
+    size_t i;
+};
+
+// edge fields as parallel columns. iterates as EdgeRef values, so the
+// templated dec_values / commit_edges read it like a vector of Edge
+struct EdgeCols {
+    std::vector<uint32_t> layer_id;
+    std::vector<uint16_t> idx;
+    std::vector<uint8_t> ch;
+    std::vector<Fp> w;
+
+    struct iterator {
+        const EdgeCols * c;
+        size_t i;
+
+        EdgeRef operator*() const { return (*c)[i]; }
+        iterator & operator++() { ++i; return *this; }
+        bool operator!=(const iterator & o) const { return i != o.i; }
+    };
+
+    size_t size() const { return w.size(); }
+    bool empty() const { return w.empty(); }
+    EdgeRef operator[](size_t i) const { return { layer_id[i], idx[i], ch[i], w[i], i }; }
+    iterator begin() const { return { this, 0 }; }
+    iterator end() const { return { this, size() }; }
+
+    void resize(size_t n) {
+        layer_id.resize(n);
+        idx.resize(n);
+        ch.resize(n);
+        w.resize(n);
+    }
+};
+
+// words per sigma in a slab, rounded up to whole cache lines so every
+// sigma starts 64 byte aligned. the words past m_bits stay zero
+inline size_t soa_wpe(uint32_t m_bits) {
+    return ((size_t)m_bits + 511) / 512 * 8;
+}
+
+inline void soa_xor_row(uint64_t* d, const uint64_t* s, size_t wpe) {
+    if (wpe == SIGMA_W) {
+        bvk::xor_words<SIGMA_W>(d, s);
+        return;
+    }
+    for (size_t q = 0; q < wpe; q++) d[q] ^= s[q];
+}
+
+inline size_t soa_popcnt_row(const uint64_t* s, size_t wpe) {
+    if (wpe == SIGMA_W) return bvk::popcnt_words<SIGMA_W>(s);
+    size_t c = 0;
+    for (size_t q = 0; q < wpe; q++) c += (size_t)__builtin_popcountll(s[q]);
+    return c;
+}
+
+// a Cipher with its edge metadata in columns and every sigma in one
+// aligned slab, sigma i at sig[i * wpe]. all sigmas are kept: lazy edges
+// are expanded on the way in and salts are not carried
+struct CipherSoA {
+    std::vector<Layer> L;
+    EdgeCols E;
+    SigmaSlab sig;
+    uint32_t m_bits = 0;
+    size_t wpe = 0;
+
+    uint64_t * sigma(size_t i) { return sig.data() + i * wpe; }
+    const uint64_t * sigma(size_t i) const { return sig.data() + i * wpe; }
+};
+
+inline CipherSoA ct_to_soa(const PubKey& pk, const Cipher& C) {
+    CipherSoA S;
+    const size_t n = C.E.size();
+    const size_t nw = ((size_t)pk.prm.m_bits + 63) / 64;
+
+    S.L = C.L;
+    S.m_bits = (uint32_t)pk.prm.m_bits;
+    S.wpe = soa_wpe(S.m_bits);
+    S.E.resize(n);
+    S.sig.assign(n * S.wpe, 0);
+
+    parallel_for(n, 64, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            const Edge& e = C.E[i];
+            S.E.layer_id[i] = e.layer_id;
+            S.E.idx[i] = e.idx;
+            S.E.ch[i] = e.ch;
+            S.E.w[i] = e.w;
+
+            edge_lazy_or(pk, C, e, [&](const BitVec& s) {
+                std::memcpy(S.sigma(i), s.w.data(), std::min(nw, s.w.size()) * 8);
+                return 0;
+            });
+        }
+    });
+
+    return S;
+}
+
+inline Cipher ct_from_soa(const CipherSoA& S) {
+    Cipher C;
+    const size_t n = S.E.size();
+    const size_t nw = ((size_t)S.m_bits + 63) / 64;
+
+    C.L = S.L;
+    C.E.resize(n);
+
+    parallel_for(n, 64, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            Edge& e = C.E[i];
+            e.layer_id = S.E.layer_id[i];
+            e.idx = S.E.idx[i];
+            e.ch = S.E.ch[i];
+            e.w = S.E.w[i];
+            e.s.nbits = S.m_bits;
+            e.s.w.assign(S.sigma(i), S.sigma(i) + nw);
+        }
+    });
+
+    return C;
+}
+
+// one straight pass over the slab, row by row
+inline double sigma_density(const PubKey& pk, const CipherSoA& S) {
+    if (S.E.empty()) return 0.0;
+
+    uint64_t ones = 0;
+    for (size_t i = 0; i < S.E.size(); i++) ones += soa_popcnt_row(S.sigma(i), S.wpe);
+
+    return (double)((long double)ones / ((long double)S.E.size() * pk.prm.m_bits));
+}
+
+// apply_perm_sigma on every sigma in place: the slab rows go through the
+// ubk network in blocks, or one scratch row per worker without one
+inline void ubk_apply(const PubKey& pk, CipherSoA& S) {
+    const size_t nb = S.m_bits;
+
+    if (!pk.ubk.net.empty() && nb == pk.ubk.inv.size()) {
+        parallel_for(S.E.size(), 64, [&](size_t lo, size_t hi) {
+            benes_apply_rows(pk.ubk.net, S.sigma(lo), hi - lo, S.wpe, nb);
+        });
+        return;
+    }
+
+    const int* inv = pk.ubk.inv.data();
+
+    parallel_for(S.E.size(), 16, [&](size_t lo, size_t hi) {
+        thread_local std::vector<uint64_t> tmp;
+        tmp.resize(S.wpe);
+
+        for (size_t i = lo; i < hi; i++) {
+            uint64_t* s = S.sigma(i);
+            std::fill(tmp.begin(), tmp.end(), 0);
+
+            for (size_t wi = 0; wi < S.wpe; wi++) {
+                for (uint64_t x = s[wi]; x; x &= x - 1) {
+                    size_t src = (wi << 6) + (size_t)__builtin_ctzll(x);
+                    if (src >= nb) break;
+                    int j = inv[src];
+                    tmp[(size_t)j >> 6] |= 1ull << (j & 63);
+                }
+            }
+
+            std::memcpy(s, tmp.data(), S.wpe * 8);
+        }
+    });
+}
+
+// the same commitment as commit_ct of the Cipher it came from
+inline std::array<uint8_t, 32> commit_ct(const PubKey& pk, const CipherSoA& S) {
+    return commit_edges(pk, S, [&](const EdgeRef& e, auto&& f) {
+        f(S.sigma(e.i), (size_t)S.m_bits);
+    });
+}
+
+// compact_edges on the columns: same key sort and run merge, a run is
+// xor-folded slab row into slab row
+inline void compact_edges(const PubKey&, CipherSoA& S) {
+    const size_t n = S.E.size();
+
+    std::vector<std::pair<uint64_t, uint32_t>> key(n);
+    for (size_t i = 0; i < n; i++) {
+        key[i] = {((uint64_t)S.E.layer_id[i] << 17) | ((uint64_t)S.E.idx[i] << 1) | (S.E.ch[i] & 1u), (uint32_t)i};
+    }
+    parallel_sort(key.begin(), key.end());
+
+    std::vector<size_t> run;
+    for (size_t i = 0; i < n; i++) if (i == 0 || key[i].first != key[i - 1].first) run.push_back(i);
+    run.push_back(n);
+
+    const size_t nr = run.size() - 1;
+    CipherSoA out;
+    out.m_bits = S.m_bits;
+    out.wpe = S.wpe;
+    out.E.resize(nr);
+    out.sig.resize(nr * S.wpe);
+    std::vector<uint8_t> keep(nr, 1);
+
+    parallel_for(nr, 64, [&](size_t lo, size_t hi) {
+        for (size_t r = lo; r < hi; r++) {
+            size_t i = key[run[r]].second;
+            Fp w = S.E.w[i];
+            uint64_t* d = out.sigma(r);
+            std::memcpy(d, S.sigma(i), S.wpe * 8);
+
+            for (size_t j = run[r] + 1; j < run[r + 1]; j++) {
+                size_t k = key[j].second;
+                const uint64_t* s = S.sigma(k);
+                w = fp_add(w, S.E.w[k]);
+                soa_xor_row(d, s, S.wpe);
+            }
+
+            out.E.layer_id[r] = S.E.layer_id[i];
+            out.E.idx[r] = S.E.idx[i];
+            out.E.ch[r] = S.E.ch[i];
+            out.E.w[r] = w;
+
+            if (!ct::fp_is_nonzero(w)) {
+                keep[r] = soa_popcnt_row(d, S.wpe) != 0;
+            }
+        }
+    });
+
+    size_t m = 0;
+    for (size_t r = 0; r < nr; r++) {
+        if (!keep[r]) continue;
+        if (m != r) {
+            out.E.layer_id[m] = out.E.layer_id[r];
+            out.E.idx[m] = out.E.idx[r];
+            out.E.ch[m] = out.E.ch[r];
+            out.E.w[m] = out.E.w[r];
+            std::memcpy(out.sigma(m), out.sigma(r), S.wpe * 8);
+        }
+        m++;
+    }
+
+    out.E.resize(m);
+    out.sig.resize(m * S.wpe);
+    out.L.swap(S.L);
+    S = std::move(out);
+}
+
+// acc += b in place: b's live layers are appended as the Cipher form
+// does, its columns and slab rows after them with the layer ids remapped.
+// false, acc untouched, when the sigma widths of acc and b differ
+inline bool ct_add_inplace(const PubKey& pk, CipherSoA& acc, const CipherSoA& b) {
+    if (&acc == &b) {
+        return ct_add_inplace(pk, acc, CipherSoA(b));
+    }
+
+    if (!acc.wpe && acc.E.empty()) {
+        acc.m_bits = b.m_bits;
+        acc.wpe = b.wpe;
+    }
+
+    if (b.E.size() && (b.wpe != acc.wpe || b.m_bits != acc.m_bits)) {
+        return false;
+    }
+
+    const size_t n0 = acc.E.size();
+    std::vector<uint32_t> remap = ct_append_layers(acc, b);
+
+    acc.E.layer_id.reserve(n0 + b.E.size());
+    for (uint32_t lid : b.E.layer_id) acc.E.layer_id.push_back(remap[lid]);
+    acc.E.idx.insert(acc.E.idx.end(), b.E.idx.begin(), b.E.idx.end());
+    acc.E.ch.insert(acc.E.ch.end(), b.E.ch.begin(), b.E.ch.end());
+    acc.E.w.insert(acc.E.w.end(), b.E.w.begin(), b.E.w.end());
+    acc.sig.insert(acc.sig.end(), b.sig.begin(), b.sig.end());
+
+    if (acc.E.size() > pk.prm.edge_budget) compact_edges(pk, acc);
+    return true;
+}
+
+}
@@ -3,90 +3,172 @@
 #include <cstdint>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <tuple>
 
 #include "../core/types.hpp"
+#include "../core/parallel.hpp"
 #include "../crypto/lpn.hpp"
+#include "../crypto/prf_cache.hpp"
 
 namespace pvac {
 
-inline Fp layer_R_cached(
+// BASE layer R values for every cipher in cs: seeds deduplicated across
+// the batch, evaluated by multi-seed prf passes spread over the workers
+template <class CT>
+inline std::vector<std::vector<Fp>> base_layer_R(
     const PubKey & pk,
     const SecKey & sk,
-    const Cipher & C,
-    uint32_t lid,
-    std::vector<int> & vis,
-    std::vector<Fp> & cache
-
+    const CT * cs,
+    size_t n,
+    PrfCache * memo
 ) {
-    if ((size_t)lid >= C.L.size()) {
-
-        std::abort();
+    struct Ref {
+        RSeed seed;
+        uint32_t ci;
+        uint32_t lid;
+    };
+
+    std::vector<Ref> refs;
+    for (size_t ci = 0; ci < n; ci++) {
+        for (size_t lid = 0; lid < cs[ci].L.size(); lid++) {
+            if (cs[ci].L[lid].rule == RRule::BASE) {
+                refs.push_back({cs[ci].L[lid].seed, (uint32_t)ci, (uint32_t)lid});
+            }
+        }
     }
 
-    if (cache[lid].lo | cache[lid].hi) 
-    
-    {
-        return cache[lid];
-    }
+    auto key = [](const RSeed & s) {
+        return std::make_tuple(s.ztag, s.nonce.lo, s.nonce.hi);
+    };
 
-    if (vis[lid]) 
-    {
-       
-        std::cerr << "[R] cycle\n";
-        std::abort();
-    }
+    std::sort(refs.begin(), refs.end(), [&](const Ref & x, const Ref & y) {
+        return key(x.seed) < key(y.seed);
+    });
 
-    vis[lid] = 1;
+    std::vector<RSeed> seeds;
+    std::vector<size_t> uniq(refs.size());
 
-    const Layer & L = C.L[lid];
-    Fp R {};
+    for (size_t i = 0; i < refs.size(); i++) {
+        if (i == 0 || key(refs[i].seed) != key(refs[i - 1].seed)) {
+            seeds.push_back(refs[i].seed);
+        }
+        uniq[i] = seeds.size() - 1;
+    }
 
-    if (L.rule == RRule::BASE) {
-        R = prf_R(pk, sk, L.seed);
-    } else {
+    // chunks of a few PRF_LANES passes each, memo is thread safe
+    std::vector<Fp> R(seeds.size());
 
-        Fp Ra = layer_R_cached(pk, sk, C, L.pa, vis, cache);
+    parallel_for(seeds.size(), 2 * PRF_LANES, [&](size_t lo, size_t hi) {
+        std::vector<RSeed> part(seeds.begin() + lo, seeds.begin() + hi);
+        std::vector<Fp> got = prf_R_batch(pk, sk, part, memo);
+        std::copy(got.begin(), got.end(), R.begin() + lo);
+    });
 
+    std::vector<std::vector<Fp>> out(n);
+    for (size_t ci = 0; ci < n; ci++) {
+        out[ci].assign(cs[ci].L.size(), fp_from_u64(0));
+    }
 
-        // test here later ( rb)
-        Fp Rb = layer_R_cached(pk, sk, C, L.pb, vis, cache);
-        R = fp_mul(Ra, Rb);
+    for (size_t i = 0; i < refs.size(); i++) {
+        out[refs[i].ci][refs[i].lid] = R[uniq[i]];
     }
 
-    vis[lid] = 0;
-    cache[lid] = R;
+    return out;
+}
 
+// R for the PROD layers in one forward pass over a topological order,
+// R must already hold the BASE values
+template <class CT>
+inline void fold_prod_R(const CT & C, const std::vector<uint32_t> & order, std::vector<Fp> & R) {
+    for (uint32_t lid : order) {
+        const Layer & L = C.L[lid];
+
+        if (L.rule == RRule::PROD) {
+            R[lid] = fp_mul(R[L.pa], R[L.pb]);
+        }
+    }
+}
+
+// every layer R of C, BASE layers evaluated in parallel
+inline std::vector<Fp> layer_R_all(
+    const PubKey & pk,
+    const SecKey & sk,
+    const Cipher & C,
+    PrfCache * memo = nullptr
+) {
+    std::vector<Fp> R = std::move(base_layer_R(pk, sk, &C, 1, memo)[0]);
+    fold_prod_R(C, layer_topo_order(C), R);
     return R;
 }
 
-inline Fp dec_value(const PubKey & pk, const SecKey & sk, const Cipher & C) {
-    size_t L = C.L.size();
+// memo (optional) carries base-layer R values across calls. every layer R
+// of the whole batch is inverted by one montgomery batch inversion. CT is
+// a Cipher or a mapped CipherView
+template <class CT>
+inline std::vector<Fp> dec_values(
+    const PubKey & pk,
+    const SecKey & sk,
+    const CT * cs,
+    size_t n,
+    PrfCache * memo = nullptr
+) {
+    std::vector<std::vector<Fp>> cache = base_layer_R(pk, sk, cs, n, memo);
 
-    std::vector<Fp> cache(L, fp_from_u64(0));
-    std::vector<int> vis(L, 0);
+    std::vector<size_t> first(n + 1, 0);
+    for (size_t ci = 0; ci < n; ci++) {
+        first[ci + 1] = first[ci] + cs[ci].L.size();
+    }
 
-    std::vector<Fp> Rinv(L, fp_from_u64(0));
+    std::vector<Fp> Rinv(first[n]);
 
-    for (size_t lid = 0; lid < L; lid++) {
-         Fp R  = layer_R_cached(pk, sk, C, (uint32_t)lid, vis, cache);
-        Rinv[lid] = fp_inv(R);
-    }
+    parallel_for(n, 16, [&](size_t lo, size_t hi) {
+        for (size_t ci = lo; ci < hi; ci++) {
+            fold_prod_R(cs[ci], layer_topo_order(cs[ci]), cache[ci]);
+            std::copy(cache[ci].begin(), cache[ci].end(), Rinv.begin() + first[ci]);
+        }
+    });
+
+    fp_batch_inv(Rinv.data(), Rinv.size());
+
+    std::vector<Fp> out(n);
+
+    parallel_for(n, 16, [&](size_t lo, size_t hi) {
+        for (size_t ci = lo; ci < hi; ci++) {
+            const Fp * ri = Rinv.data() + first[ci];
+            Fp acc = fp_from_u64(0);
 
-    Fp acc = fp_from_u64(0);
+            for (const auto & e : cs[ci].E) {
+                Fp term = fp_mul(e.w, pk.powg_B[e.idx]);
+                term = fp_mul(term, ri[e.layer_id]);
 
-    for (const auto & e : C.E) {
-        Fp term = fp_mul(e.w, pk.powg_B[e.idx]);
-        term = fp_mul(term, Rinv[e.layer_id]);
+                if (e.ch == SGN_P) {
+                    acc = fp_add(acc, term);
+                } else {
+                    acc = fp_sub(acc, term);
+                }
+            }
 
-        if (e.ch == SGN_P) {
-            acc = fp_add(acc, term);
-        } else {
-            acc = fp_sub(acc, term);
+            out[ci] = acc;
         }
-    }
+    });
 
-    return acc;
+    return out;
 }
 
+inline std::vector<Fp> dec_values(
+    const PubKey & pk,
+    const SecKey & sk,
+    const std::vector<Cipher> & cs,
+    PrfCache * memo = nullptr
+) {
+    return dec_values(pk, sk, cs.data(), cs.size(), memo);
+}
 
-}
\ No newline at end of file
+template <class CT>
+inline Fp dec_value(const PubKey & pk, const SecKey & sk, const CT & C, PrfCache * memo = nullptr) {
+    return dec_values(pk, sk, &C, 1, memo)[0];
+}
+
+
+}
@@ -2,12 +2,15 @@
 
 #include <cstdint>
 #include <cmath>
+#include <cstring>
 #include <vector>
 #include <unordered_set>
 #include <utility>
 
 #include "../core/types.hpp"
+#include "../core/parallel.hpp"
 #include "../crypto/lpn.hpp"
+#include "../crypto/prf_cache.hpp"
 #include "../crypto/matrix.hpp"
 #include "../core/ct_safe.hpp"
 
@@ -26,66 +29,121 @@ inline std::pair<int,int> plan_noise(const PubKey& pk, int depth_hint) {
     return {z2, z3};
 }
 
+// f(sigma of e) without copying a kept sigma
+template <class F>
+inline auto edge_lazy_or(const PubKey& pk, const Cipher& C, const Edge& e, F&& f) {
+    return edge_sigma_lazy(e) ? f(edge_sigma(pk, C, e)) : f(e.s);
+}
+
 inline double sigma_density(const PubKey& pk, const Cipher& C) {
     if (C.E.empty()) return 0.0;
     long double ones = 0, total = 0;
     for (const auto& e : C.E) {
-        ones += e.s.popcnt();
+        ones += edge_lazy_or(pk, C, e, [](const BitVec& s) { return s.popcnt(); });
         total += pk.prm.m_bits;
     }
     return (double)(ones / total);
 }
 
+// xor-merge edges sharing (layer, idx, sign): edges are sorted by that
+// key (in parallel on big ciphers) and every run is folded into its first
+// edge. a run of one keeps its edge as is, salt and all, so lazy sigmas
+// stay lazy; like a merged run it is dropped when weight and sigma are
+// both zero, a lazy one on its weight alone since its sigma comes from
+// the seed. peak memory is one key per edge next to the edges
 inline void compact_edges(const PubKey& pk, Cipher& C) {
-    int B = pk.prm.B;
-    size_t L = C.L.size();
-
-    struct Agg { bool have_p = false, have_m = false; Fp wp, wm; BitVec sp, sm; };
-    std::vector<Agg> acc(L * B);
-
-    for (const auto& e : C.E) {
-        Agg& a = acc[(size_t)e.layer_id * B + e.idx];
-        if (e.ch == SGN_P) {
-            if (!a.have_p) { a.wp = fp_from_u64(0); a.sp = BitVec::make(pk.prm.m_bits); a.have_p = true; }
-            a.wp = fp_add(a.wp, e.w);
-            a.sp.xor_with(e.s);
-        } else {
-            if (!a.have_m) { a.wm = fp_from_u64(0); a.sm = BitVec::make(pk.prm.m_bits); a.have_m = true; }
-            a.wm = fp_add(a.wm, e.w);
-            a.sm.xor_with(e.s);
-        }
+    const size_t n = C.E.size();
+
+    // (layer << 17 | idx << 1 | sign, position), the position keeps the
+    // merge order independent of the sort
+    std::vector<std::pair<uint64_t, uint32_t>> key(n);
+    for (size_t i = 0; i < n; i++) {
+        const Edge& e = C.E[i];
+        key[i] = {((uint64_t)e.layer_id << 17) | ((uint64_t)e.idx << 1) | (e.ch & 1u), (uint32_t)i};
     }
-
-    auto nz = [](const Fp& w, const BitVec& s) { return ct::fp_is_nonzero(w) || s.popcnt() != 0; };
-
-    std::vector<Edge> out;
-    out.reserve(C.E.size());
-    for (size_t lid = 0; lid < L; lid++) {
-        for (int k = 0; k < B; k++) {
-            Agg& a = acc[lid * (size_t)B + k];
-            if (a.have_p && nz(a.wp, a.sp)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_P, a.wp, a.sp});
-            if (a.have_m && nz(a.wm, a.sm)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_M, a.wm, a.sm});
+    parallel_sort(key.begin(), key.end());
+
+    std::vector<size_t> run;
+    for (size_t i = 0; i < n; i++) if (i == 0 || key[i].first != key[i - 1].first) run.push_back(i);
+    run.push_back(n);
+
+    const size_t nr = run.size() - 1;
+    std::vector<Edge> out(nr);
+    std::vector<uint8_t> keep(nr, 1);
+
+    parallel_for(nr, 64, [&](size_t lo, size_t hi) {
+        for (size_t r = lo; r < hi; r++) {
+            Edge& x = out[r];
+            x = std::move(C.E[key[run[r]].second]);
+            if (run[r + 1] - run[r] == 1) {
+                keep[r] = ct::fp_is_nonzero(x.w) || (!edge_sigma_lazy(x) && x.s.popcnt() != 0);
+                continue;
+            }
+
+            if (edge_sigma_lazy(x)) x.s = edge_sigma(pk, C, x);
+            x.salt = 0;
+            x.salted = false;
+
+            // full width runs fold into an aligned SigmaBits row
+            if (x.s.nbits == SIGMA_BITS && x.s.w.size() == SIGMA_W) {
+                SigmaBits acc;
+                std::memcpy(acc.w, x.s.w.data(), sizeof(acc.w));
+
+                for (size_t j = run[r] + 1; j < run[r + 1]; j++) {
+                    const Edge& e = C.E[key[j].second];
+                    x.w = fp_add(x.w, e.w);
+                    edge_lazy_or(pk, C, e, [&](const BitVec& s) {
+                        if (s.w.size() == SIGMA_W) acc.xor_with(s.w.data());
+                        else for (size_t q = 0; q < std::min(SIGMA_W, s.w.size()); q++) acc.w[q] ^= s.w[q];
+                        return 0;
+                    });
+                }
+
+                std::memcpy(x.s.w.data(), acc.w, sizeof(acc.w));
+                keep[r] = ct::fp_is_nonzero(x.w) || acc.popcnt() != 0;
+                continue;
+            }
+
+            for (size_t j = run[r] + 1; j < run[r + 1]; j++) {
+                const Edge& e = C.E[key[j].second];
+                x.w = fp_add(x.w, e.w);
+                edge_lazy_or(pk, C, e, [&](const BitVec& s) { x.s.xor_with(s); return 0; });
+            }
+
+            keep[r] = ct::fp_is_nonzero(x.w) || x.s.popcnt() != 0;
         }
-    }
+    });
+
+    size_t m = 0;
+    for (size_t r = 0; r < nr; r++) if (keep[r]) { if (m != r) out[m] = std::move(out[r]); m++; }
+    out.resize(m);
     C.E.swap(out);
 }
 
-inline void compact_layers(Cipher& C) {
+// layers some edge of C reaches, directly or as an ancestor
+template <class CT>
+inline std::vector<uint8_t> layer_live(const CT& C) {
     const size_t L = C.L.size();
-    if (L == 0) return;
-
     std::vector<uint8_t> used(L, 0);
     for (const auto& e : C.E) if (e.layer_id < L) used[e.layer_id] = 1;
 
-    for (bool changed = true; changed; ) {
-        changed = false;
-        for (size_t lid = 0; lid < L; ++lid) {
-            if (!used[lid] || C.L[lid].rule != RRule::PROD) continue;
-            auto mark = [&](uint32_t p) { if (p < L && !used[p]) { used[p] = 1; changed = true; } };
-            mark(C.L[lid].pa);
-            mark(C.L[lid].pb);
-        }
+    // children before parents: one reverse topological sweep marks
+    // every ancestor of a used layer
+    std::vector<uint32_t> order = layer_topo_order(C);
+    for (size_t i = L; i-- > 0; ) {
+        const Layer& Lr = C.L[order[i]];
+        if (!used[order[i]] || Lr.rule != RRule::PROD) continue;
+        used[Lr.pa] = 1;
+        used[Lr.pb] = 1;
     }
+    return used;
+}
+
+inline void compact_layers(Cipher& C) {
+    const size_t L = C.L.size();
+    if (L == 0) return;
+
+    std::vector<uint8_t> used = layer_live(C);
 
     std::vector<uint32_t> remap(L, UINT32_MAX);
     std::vector<Layer> newL;
@@ -111,8 +169,7 @@ inline void guard_budget(const PubKey& pk, Cipher& C, const char* where) {
 }
 
 // ndt (new)
-inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
-                          const RSeed& base_seed, uint32_t group_id, uint8_t kind) {
+inline RSeed noise_delta_seed(const RSeed& base_seed, uint32_t group_id, uint8_t kind) {
     RSeed s2 = base_seed;
     uint64_t g = (uint64_t)group_id + 1;
     uint64_t k = (uint64_t)kind + 1;
@@ -125,7 +182,17 @@ inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
     s2.nonce.hi ^= (k << 32);
     s2.ztag ^= (k << 48);
 
-    return prf_R_noise(pk, sk, s2);
+    return s2;
+}
+
+inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
+                          const RSeed& base_seed, uint32_t group_id, uint8_t kind) {
+    return prf_R_noise(pk, sk, noise_delta_seed(base_seed, group_id, kind));
+}
+
+inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
+                          const RSeed& base_seed, uint32_t group_id, uint8_t kind, PrfCache* memo) {
+    return prf_R_noise(pk, sk, noise_delta_seed(base_seed, group_id, kind), memo);
 }
 
 inline int pick_unique_idx(int B, std::unordered_set<int>& used) {
@@ -149,11 +216,25 @@ inline int pick_distinct_idx2(int B, int ex1, int ex2) {
 
 inline Edge make_edge(uint32_t lid, uint16_t idx, uint8_t ch, Fp w,
                       const PubKey& pk, const RSeed& seed) {
-    return {lid, idx, ch, w, sigma_from_H(pk, seed.ztag, seed.nonce, idx, ch, csprng_u64())};
+    uint64_t salt = csprng_u64();
+    BitVec s = pk.prm.lazy_sigma ? BitVec{} : sigma_from_H(pk, seed.ztag, seed.nonce, idx, ch, salt);
+    return {lid, idx, ch, w, std::move(s), salt, true};
 }
 
-inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int depth_hint) {
+// base edges of a fresh layer, the last two close the sum to the value
+inline constexpr int ENC_S = 8;
+
+// an enc_fp_depth with everything but the two closing weights done: R,
+// the noise groups, the indices, signs and sigmas. those two weights are
+// the only part that depends on the value. single use
+struct PreparedFp {
     Cipher C;
+    Fp R, sum1, sumg, inv_gab;
+};
+
+inline PreparedFp enc_fp_prepare(const PubKey& pk, const SecKey& sk, int depth_hint) {
+    PreparedFp P;
+    Cipher& C = P.C;
 
     Layer L;
     L.rule = RRule::BASE;
@@ -161,13 +242,14 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
     L.seed.ztag = prg_layer_ztag(pk.canon_tag, L.seed.nonce);
     C.L.push_back(L);
 
-    constexpr int S = 8;
-    std::unordered_set<int> used;
+    constexpr int S = ENC_S;
+    thread_local std::unordered_set<int> used;
+    used.clear();
     used.reserve(S * 2);
 
     std::vector<int> idx(S);
     std::vector<uint8_t> ch(S);
-    std::vector<Fp> r(S);
+    std::vector<Fp> r(S, fp_from_u64(0));
 
     for (int j = 0; j < S; j++) {
         idx[j] = pick_unique_idx(pk.prm.B, used);
@@ -183,34 +265,44 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         sumg = s > 0 ? fp_add(sumg, term) : fp_sub(sumg, term);
     }
 
-    int ia = idx[S-2], ib = idx[S-1];
-    int sa = sgn_val(ch[S-2]), sb = sgn_val(ch[S-1]);
-    Fp ga = pk.powg_B[ia], gb = pk.powg_B[ib];
+    P.sum1 = sum1;
+    P.sumg = sumg;
+    P.inv_gab = fp_inv(fp_sub(pk.powg_B[idx[S-2]], pk.powg_B[idx[S-1]]));
 
-    Fp V = fp_sub(v, sumg);
-    Fp rhs = fp_sub(fp_neg(fp_mul(sum1, ga)), V);
-    Fp rb = fp_mul(rhs, fp_inv(fp_sub(ga, gb)));
-    if (sb < 0) rb = fp_neg(rb);
+    auto [Z2, Z3] = plan_noise(pk, depth_hint);
+    int total_groups = Z2 + Z3;
 
-    Fp tmp = sb > 0 ? fp_sub(fp_neg(sum1), rb) : fp_add(fp_neg(sum1), rb);
-    Fp ra = sa > 0 ? tmp : fp_neg(tmp);
+    // R and every noise delta but the closing one go through one prf pass
+    std::vector<PrfJob> jobs;
+    jobs.reserve(3 * (size_t)std::max(1, total_groups));
+    jobs.push_back({L.seed, Dom::PRF_R1});
+    jobs.push_back({L.seed, Dom::PRF_R2});
+    jobs.push_back({L.seed, Dom::PRF_R3});
+
+    for (int g = 0; g + 1 < total_groups; ++g) {
+        RSeed s2 = noise_delta_seed(L.seed, (uint32_t)g, g < Z2 ? 0 : 1);
+        jobs.push_back({s2, Dom::PRF_NOISE1});
+        jobs.push_back({s2, Dom::PRF_NOISE2});
+        jobs.push_back({s2, Dom::PRF_NOISE3});
+    }
 
-    r[S-2] = ra;
-    r[S-1] = rb;
+    std::vector<Fp> prf;
+    prf_core_batch(pk, sk, jobs, prf);
+    auto prf3 = [&](size_t j) { return fp_mul(fp_mul(prf[3 * j], prf[3 * j + 1]), prf[3 * j + 2]); };
 
-    Fp R = prf_R(pk, sk, L.seed);
+    Fp R = prf3(0);
+    P.R = R;
 
+    // the closing two get their weights in enc_fp_finish
     for (int j = 0; j < S; j++)
         C.E.push_back(make_edge(0, idx[j], ch[j], fp_mul(r[j], R), pk, L.seed));
 
-    auto [Z2, Z3] = plan_noise(pk, depth_hint);
-    int total_groups = Z2 + Z3;
     Fp delta_acc = fp_from_u64(0);
     int group_id = 0;
 
-    auto next_delta = [&](int groups_left, uint8_t kind) -> Fp {
+    auto next_delta = [&](int groups_left) -> Fp {
         if (groups_left <= 1) return fp_neg(delta_acc);
-        Fp d = prf_noise_delta(pk, sk, L.seed, group_id, kind);
+        Fp d = prf3(1 + (size_t)group_id);
         delta_acc = fp_add(delta_acc, d);
         return d;
     };
@@ -222,7 +314,7 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         uint8_t s1 = csprng_u64() & 1, s2 = s1 ^ 1;
         int sign1 = sgn_val(s1);
 
-        Fp Delta = next_delta(total_groups - group_id, 0);
+        Fp Delta = next_delta(total_groups - group_id);
         Fp Delta_prime = sign1 > 0 ? Delta : fp_neg(Delta);
 
         Fp gi = pk.powg_B[i], gj = pk.powg_B[j];
@@ -241,7 +333,7 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         uint8_t s1 = csprng_u64() & 1, s2 = csprng_u64() & 1, s3 = csprng_u64() & 1;
         int sign1 = sgn_val(s1), sign2 = sgn_val(s2), sign3 = sgn_val(s3);
 
-        Fp Delta = next_delta(total_groups - group_id, 1);
+        Fp Delta = next_delta(total_groups - group_id);
         Fp a = rand_fp_nonzero(), b = rand_fp_nonzero();
 
         Fp term1 = fp_mul(a, pk.powg_B[i]);
@@ -257,10 +349,51 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         C.E.push_back(make_edge(0, k, s3, fp_mul(c, R), pk, L.seed));
     }
 
+    return P;
+}
+
+// the closing weights for v: a handful of field ops, no prf or sigma work.
+// P is left empty and its secret sums wiped, so a second finish aborts
+inline Cipher enc_fp_finish(const PubKey& pk, PreparedFp&& P, const Fp& v) {
+    constexpr int S = ENC_S;
+    Cipher C = std::move(P.C);
+    P.C.E.clear();
+    P.C.L.clear();
+    if (C.E.size() < (size_t)S || C.L.size() != 1) {
+        std::cerr << "[enc] PreparedFp finished twice or never prepared\n";
+        std::abort();
+    }
+    Edge& ea = C.E[S-2];
+    Edge& eb = C.E[S-1];
+
+    int sa = sgn_val(ea.ch), sb = sgn_val(eb.ch);
+    Fp ga = pk.powg_B[ea.idx];
+
+    Fp V = fp_sub(v, P.sumg);
+    Fp rhs = fp_sub(fp_neg(fp_mul(P.sum1, ga)), V);
+    Fp rb = fp_mul(rhs, P.inv_gab);
+    if (sb < 0) rb = fp_neg(rb);
+
+    Fp tmp = sb > 0 ? fp_sub(fp_neg(P.sum1), rb) : fp_add(fp_neg(P.sum1), rb);
+    Fp ra = sa > 0 ? tmp : fp_neg(tmp);
+
+    ea.w = fp_mul(ra, P.R);
+    eb.w = fp_mul(rb, P.R);
+
+    csprng_wipe(&P.R, sizeof(Fp));
+    csprng_wipe(&P.sum1, sizeof(Fp));
+    csprng_wipe(&P.sumg, sizeof(Fp));
+    csprng_wipe(&P.inv_gab, sizeof(Fp));
+
+    // not before: a compaction could merge the closing edges away
     guard_budget(pk, C, "enc");
     return C;
 }
 
+inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int depth_hint) {
+    return enc_fp_finish(pk, enc_fp_prepare(pk, sk, depth_hint), v);
+}
+
 inline Cipher combine_ciphers(const PubKey& pk, const Cipher& a, const Cipher& b) {
     Cipher C;
     C.L.reserve(a.L.size() + b.L.size());
@@ -282,6 +415,26 @@ inline Cipher combine_ciphers(const PubKey& pk, const Cipher& a, const Cipher& b
     return C;
 }
 
+// fresh ciphers are moved in rather than copied, sigmas included
+inline Cipher combine_ciphers(const PubKey& pk, Cipher&& a, Cipher&& b) {
+    Cipher C = std::move(a);
+    uint32_t off = (uint32_t)C.L.size();
+    C.L.reserve(off + b.L.size());
+    C.E.reserve(C.E.size() + b.E.size());
+
+    for (auto L : b.L) {
+        if (L.rule == RRule::PROD) { L.pa += off; L.pb += off; }
+        C.L.push_back(L);
+    }
+
+    for (auto& e : b.E) { e.layer_id += off; C.E.push_back(std::move(e)); }
+    b.E.clear();
+
+    guard_budget(pk, C, "combine");
+    compact_layers(C);
+    return C;
+}
+
 inline Cipher enc_value_depth(const PubKey& pk, const SecKey& sk, uint64_t v, int depth_hint) {
     Fp val = fp_from_u64(v);
     Fp mask = rand_fp_nonzero();
@@ -301,4 +454,54 @@ inline Cipher enc_zero_depth(const PubKey& pk, const SecKey& sk, int depth_hint)
         enc_fp_depth(pk, sk, fp_neg(mask), depth_hint));
 }
 
+// enc_value_depth of vs[0..n) into out[0..n). values are handed to the
+// workers one at a time off a shared counter, so a slow one does not
+// hold up a whole slice; each worker reuses its prf and index scratch
+inline void enc_values(const PubKey& pk, const SecKey& sk, const uint64_t* vs, size_t n,
+                       int depth_hint, Cipher* out) {
+    parallel_for(n, 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) out[i] = enc_value_depth(pk, sk, vs[i], depth_hint);
+    });
+}
+
+inline std::vector<Cipher> enc_values(const PubKey& pk, const SecKey& sk,
+                                      const std::vector<uint64_t>& vs, int depth_hint = 0) {
+    std::vector<Cipher> out(vs.size());
+    enc_values(pk, sk, vs.data(), vs.size(), depth_hint, out.data());
+    return out;
+}
+
+// an enc_value with all of the prf, lpn and sigma work done ahead of
+// time: the mask half is finished, the value half waits for v
+struct PreparedEncryption {
+    PreparedFp a;   // becomes enc(v + mask)
+    Cipher b;       // enc(-mask)
+    Fp mask;
+};
+
+inline PreparedEncryption prepare_encryption(const PubKey& pk, const SecKey& sk, int depth_hint) {
+    PreparedEncryption P;
+    P.mask = rand_fp_nonzero();
+    P.a = enc_fp_prepare(pk, sk, depth_hint);
+    P.b = enc_fp_depth(pk, sk, fp_neg(P.mask), depth_hint);
+    return P;
+}
+
+// n of them across the workers
+inline std::vector<PreparedEncryption> prepare_encryptions(const PubKey& pk, const SecKey& sk,
+                                                           size_t n, int depth_hint) {
+    std::vector<PreparedEncryption> out(n);
+    parallel_for(n, 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) out[i] = prepare_encryption(pk, sk, depth_hint);
+    });
+    return out;
+}
+
+// the online half: two closing weights and a move, no sk needed. P is
+// spent, finishing the same preparation twice would reuse its noise
+inline Cipher enc_value_prepared(const PubKey& pk, PreparedEncryption&& P, uint64_t v) {
+    Fp x = fp_add(fp_from_u64(v), P.mask);
+    return combine_ciphers(pk, enc_fp_finish(pk, std::move(P.a), x), std::move(P.b));
+}
+
 }
@@ -30,7 +30,7 @@ inline Cipher ct_recrypt(const PubKey& pk, const EvalKey& ek, const Cipher& in)
     
     for (int it = 0; it < 8 && sigma_needs_balance(pk, result); ++it) {
         size_t idx = csprng_u64() % ek.zero_pool.size();
-        result = ct_add(pk, result, ek.zero_pool[idx]);
+        ct_add_inplace(pk, result, ek.zero_pool[idx]);
         ubk_apply(pk, result);
         guard_budget(pk, result, "recrypt");
     }
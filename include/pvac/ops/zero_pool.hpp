@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../core/types.hpp"
+#include "../core/ring.hpp"
+#include "encrypt.hpp"
+#include "arithmetic.hpp"
+#include "recrypt.hpp"
+
+namespace pvac {
+
+struct PoolStats {
+    size_t depth = 0;          // ready items right now
+    size_t low = 0;            // refill starts below this depth
+    size_t high = 0;           // and stops at this one
+    uint64_t made = 0;         // produced by the workers
+    uint64_t taken = 0;        // handed out from the ring
+    uint64_t misses = 0;       // take() on an empty ring, made inline
+    double refill_per_s = 0;   // items per second a worker spends making them
+};
+
+// items made ahead of time by background workers. workers fill the ring
+// up to high and then sleep until takers drain it below low; take() pops
+// without locking and only falls back to make() on the calling thread
+// when the ring is empty. make must be thread safe when workers > 1
+template <class T>
+class FreshPool {
+public:
+    FreshPool(std::function<T()> make, size_t high, size_t low, int workers)
+        : make_(std::move(make)),
+          high_(std::max<size_t>(1, high)),
+          low_(std::min(std::max<size_t>(1, low), high_)),
+          ring_(high_ + (size_t)std::max(1, workers)) {
+        for (int i = 0; i < std::max(1, workers); i++) {
+            th_.emplace_back([this] { work(); });
+        }
+    }
+
+    FreshPool(const FreshPool &) = delete;
+    FreshPool & operator=(const FreshPool &) = delete;
+
+    ~FreshPool() {
+        stop();
+    }
+
+    // joins the workers, items left in the ring stay takeable
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+
+        for (auto & t : th_) {
+            if (t.joinable()) t.join();
+        }
+    }
+
+    bool try_take(T & out) {
+        if (!ring_.pop(out)) {
+            return false;
+        }
+
+        taken_.fetch_add(1, std::memory_order_relaxed);
+        poke();
+        return true;
+    }
+
+    T take() {
+        T x;
+
+        if (try_take(x)) {
+            return x;
+        }
+
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        poke();
+        return make_();
+    }
+
+    // blocks until depth reaches n (at most high) or timeout_ms passes
+    bool wait_depth(size_t n, int timeout_ms) {
+        n = std::min(n, high_);
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+        while (ring_.size() < n) {
+            if (std::chrono::steady_clock::now() >= end) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return true;
+    }
+
+    PoolStats stats() const {
+        PoolStats s;
+        s.depth = ring_.size();
+        s.low = low_;
+        s.high = high_;
+        s.made = made_.load(std::memory_order_relaxed);
+        s.taken = taken_.load(std::memory_order_relaxed);
+        s.misses = misses_.load(std::memory_order_relaxed);
+
+        uint64_t ns = busy_ns_.load(std::memory_order_relaxed);
+        s.refill_per_s = ns ? (double)s.made * 1e9 / (double)ns : 0.0;
+        return s;
+    }
+
+private:
+    std::function<T()> make_;
+    size_t high_;
+    size_t low_;
+    MpmcRing<T> ring_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::vector<std::thread> th_;
+
+    std::atomic<uint64_t> made_ { 0 };
+    std::atomic<uint64_t> taken_ { 0 };
+    std::atomic<uint64_t> misses_ { 0 };
+    std::atomic<uint64_t> busy_ns_ { 0 };
+
+    // wakes the workers once the ring is below low. the empty critical
+    // section orders this against a worker between its check and its wait
+    void poke() {
+        if (ring_.size() < low_) {
+            { std::lock_guard<std::mutex> lk(mu_); }
+            cv_.notify_all();
+        }
+    }
+
+    void work() {
+        bool full = false;
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+
+                if (full || ring_.size() >= high_) {
+                    full = true;
+                    cv_.wait(lk, [&] { return stop_ || ring_.size() < low_; });
+                    full = false;
+                }
+
+                if (stop_) {
+                    return;
+                }
+            }
+
+            auto t0 = std::chrono::steady_clock::now();
+            T x = make_();
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+
+            busy_ns_.fetch_add((uint64_t)ns, std::memory_order_relaxed);
+            made_.fetch_add(1, std::memory_order_relaxed);
+
+            // the ring has one spare slot per worker past high, a push
+            // only fails if takers and workers race right at the edge
+            ring_.push(std::move(x));
+        }
+    }
+};
+
+// fresh encryptions of zero and of one at a fixed depth hint, kept topped
+// up in the background. pk and sk must outlive the pool
+struct ZeroPool {
+    FreshPool<Cipher> zero;
+    FreshPool<Cipher> one;
+
+    ZeroPool(const PubKey& pk, const SecKey& sk, int depth_hint,
+             size_t zeros = 64, size_t ones = 8, int workers = 1)
+        : zero([&pk, &sk, depth_hint] { return enc_zero_depth(pk, sk, depth_hint); },
+               zeros, zeros / 4, workers),
+          one([&pk, &sk, depth_hint] { return enc_value_depth(pk, sk, 1, depth_hint); },
+              ones, ones / 4, 1) {}
+};
+
+// an EvalKey drawn from the pool instead of encrypted on the spot
+inline EvalKey make_evalkey(ZeroPool& zp, size_t pool_size) {
+    EvalKey ek;
+    ek.zero_pool.reserve(pool_size);
+    for (size_t i = 0; i < pool_size; ++i)
+        ek.zero_pool.push_back(zp.zero.take());
+    ek.enc_one = zp.one.take();
+    return ek;
+}
+
+// as ct_recrypt with an EvalKey, but every round adds a zero that has
+// never been used before rather than one picked from a fixed set
+inline Cipher ct_recrypt(const PubKey& pk, ZeroPool& zp, const Cipher& in) {
+    if (in.E.empty()) return in;
+
+    Cipher result = in;
+
+    for (int it = 0; it < 8 && sigma_needs_balance(pk, result); ++it) {
+        ct_add_inplace(pk, result, zp.zero.take());
+        ubk_apply(pk, result);
+        guard_budget(pk, result, "recrypt");
+    }
+
+    compact_edges(pk, result);
+    compact_layers(result);
+    return result;
+}
+
+}
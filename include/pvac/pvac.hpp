@@ -7,17 +7,26 @@
 #include "pvac/core/field.hpp"
 #include "pvac/core/bitvec.hpp"
 #include "pvac/core/types.hpp"
+#include "pvac/core/parallel.hpp"
+#include "pvac/core/mapped_file.hpp"
 
 #include "pvac/crypto/toeplitz.hpp"
 #include "pvac/crypto/matrix.hpp"
 #include "pvac/crypto/lpn.hpp"
+#include "pvac/crypto/prf_cache.hpp"
 #include "pvac/crypto/keygen.hpp"
+#include "pvac/crypto/pk_cache.hpp"
 
 #include "pvac/ops/encrypt.hpp"
 #include "pvac/ops/decrypt.hpp"
 #include "pvac/ops/arithmetic.hpp"
 #include "pvac/ops/recrypt.hpp"
+#include "pvac/ops/zero_pool.hpp"
 #include "pvac/ops/commit.hpp"
+#include "pvac/ops/ct_soa.hpp"
+
+#include "pvac/io/ct_file.hpp"
+#include "pvac/io/ct_stream.hpp"
 
 #include "pvac/utils/text.hpp"
 #include "pvac/utils/metrics.hpp"
@@ -26,7 +26,65 @@ int main() {
     Fp r = prf_R(pk, sk, seed);
     auto t1 = Clock::now();
     std::cout << "prf_R: " << std::chrono::duration<double>(t1-t0).count() << "s\n";
+
+    std::cout << "\n- prf_R batch -\n";
+    std::vector<RSeed> seeds(16);
+    for (auto& s : seeds) {
+        s.nonce = make_nonce128();
+        s.ztag = prg_layer_ztag(pk.canon_tag, s.nonce);
+    }
+
+    t0 = Clock::now();
+    for (const auto& s : seeds) r = fp_add(r, prf_R(pk, sk, s));
+    t1 = Clock::now();
+    double t_scalar = std::chrono::duration<double>(t1-t0).count();
+
+    t0 = Clock::now();
+    for (const auto& x : prf_R_batch(pk, sk, seeds)) r = fp_add(r, x);
+    t1 = Clock::now();
+    double t_batch = std::chrono::duration<double>(t1-t0).count();
+
+    std::cout << "scalar: " << seeds.size() / t_scalar << " seeds/s\n";
+    std::cout << "batch: " << seeds.size() / t_batch << " seeds/s\n";
+    std::cout << "gain: " << t_scalar / t_batch << "x\n";
     
+    std::cout << "\n- aes ctr keystream -\n";
+    std::vector<uint64_t> ks(1u << 20);
+    uint8_t key[32] = {7};
+    AesCtr256 prg;
+    uint64_t acc = 0;
+
+    prg.init(key, 0);
+    t0 = Clock::now();
+    for (auto& w : ks) w = prg.next_u64();
+    t1 = Clock::now();
+    acc ^= ks[ks.size() - 1];
+    std::cout << "next_u64: " << ks.size() * 8 / 1e9 / std::chrono::duration<double>(t1-t0).count() << " GB/s\n";
+
+    select_aes_ctr();
+    int native_impl = g_aes_impl;
+    for (int impl = 1; impl <= 3; ++impl) {
+        if (!aes_ctr_has_impl(impl)) continue;
+        g_aes_impl = impl;
+        prg.init(key, 0);
+        t0 = Clock::now();
+        for (int it = 0; it < 8; ++it) prg.fill_u64(ks.data(), ks.size());
+        t1 = Clock::now();
+        acc ^= ks[ks.size() - 1];
+        std::cout << (impl == 2 ? "fill_u64 vaes512: " : impl == 3 ? "fill_u64 vaes256: " : "fill_u64 aes-ni x8: ")
+                  << 8 * ks.size() * 8 / 1e9 / std::chrono::duration<double>(t1-t0).count() << " GB/s\n";
+    }
+    g_aes_impl = native_impl;
+    volatile uint64_t sink = acc;
+    (void)sink;
+
+    std::cout << "\n- csprng -\n";
+    t0 = Clock::now();
+    for (int i = 0; i < 1000000; i++) acc ^= csprng_u64();
+    t1 = Clock::now();
+    std::cout << "csprng_u64: " << 1e6 / std::chrono::duration<double>(t1-t0).count() << " calls/s\n";
+    sink = acc;
+
     std::cout << "\n- enc_value -\n";
     t0 = Clock::now();
     Cipher c = enc_value(pk, sk, 42);
@@ -34,6 +92,24 @@ int main() {
     std::cout << "enc_value: " << std::chrono::duration<double>(t1-t0).count() << "s\n";
     std::cout << "edges: " << c.E.size() << "\n";
     std::cout << "layers: " << c.L.size() << "\n";
+
+    std::cout << "\n- dec batch -\n";
+    std::vector<Cipher> cs;
+    for (int i = 0; i < 32; i++) cs.push_back(enc_value(pk, sk, (uint64_t)i));
+
+    t0 = Clock::now();
+    for (const auto& x : cs) r = fp_add(r, dec_value(pk, sk, x));
+    t1 = Clock::now();
+    double t_one = std::chrono::duration<double>(t1-t0).count();
+
+    t0 = Clock::now();
+    for (const auto& x : dec_values(pk, sk, cs)) r = fp_add(r, x);
+    t1 = Clock::now();
+    double t_all = std::chrono::duration<double>(t1-t0).count();
+
+    std::cout << "dec_value: " << cs.size() / t_one << " ct/s\n";
+    std::cout << "dec_values: " << cs.size() / t_all << " ct/s\n";
+    std::cout << "gain: " << t_one / t_all << "x\n";
     
     return 0;
 }
\ No newline at end of file
@@ -19,6 +19,7 @@ namespace Magic {
     constexpr uint32_t SK = 0x66666999;
     constexpr uint32_t PK = 0x06660666;
     constexpr uint32_t VER = 1;
+    constexpr uint32_t PK_VER = 2; // pk with prg_ver, a VER pk is prg v1
 }
 
 namespace io {
@@ -165,7 +166,7 @@ auto loadSk = [](const std::string& path) -> SecKey {
 auto savePk = [](const PubKey& pk, const std::string& path) {
     std::ofstream o(path, std::ios::binary);
     io::put32(o, Magic::PK);
-    io::put32(o, Magic::VER);
+    io::put32(o, Magic::PK_VER);
     io::put32(o, pk.prm.m_bits);
     io::put32(o, pk.prm.B);
     io::put32(o, pk.prm.lpn_t);
@@ -177,10 +178,11 @@ auto savePk = [](const PubKey& pk, const std::string& path) {
     uint64_t t2; std::memcpy(&t2, &pk.prm.tuple2_fraction, 8);
     io::put64(o, t2);
     io::put32(o, pk.prm.edge_budget);
+    io::put32(o, (uint32_t)pk.prm.prg_ver);
     io::put64(o, pk.canon_tag);
     o.write(reinterpret_cast<const char*>(pk.H_digest.data()), 32);
     io::put64(o, pk.H.size());
-    for (const auto& h : pk.H) io::putBv(o, h);
+    for (const auto& h : h_to_dense(pk.H)) io::putBv(o, h);
     io::put64(o, pk.ubk.perm.size());
     for (auto v : pk.ubk.perm) io::put32(o, v);
     io::put64(o, pk.ubk.inv.size());
@@ -192,7 +194,8 @@ auto savePk = [](const PubKey& pk, const std::string& path) {
 
 auto loadPk = [](const std::string& path) -> PubKey {
     std::ifstream i(path, std::ios::binary);
-    if (!i || io::get32(i) != Magic::PK || io::get32(i) != Magic::VER)
+    uint32_t ver = 0;
+    if (!i || io::get32(i) != Magic::PK || ((ver = io::get32(i)) != Magic::VER && ver != Magic::PK_VER))
         throw std::runtime_error("bad PK: " + path);
 
 
@@ -215,12 +218,16 @@ auto loadPk = [](const std::string& path) -> PubKey {
     uint64_t t2 = io::get64(i);
     std::memcpy(&pk.prm.tuple2_fraction, &t2, 8);
     pk.prm.edge_budget = io::get32(i);
+    // v1 files predate prg v2: their H and sigmas come from the sha256 stream
+    pk.prm.prg_ver = ver >= Magic::PK_VER ? (int)io::get32(i) : 1;
     pk.canon_tag = io::get64(i);
 
     i.read(reinterpret_cast<char*>(pk.H_digest.data()), 32);
-    pk.H.resize(io::get64(i));
+    std::vector<BitVec> Hd(io::get64(i));
+
+    for (auto& h : Hd) h = io::getBv(i);
 
-    for (auto& h : pk.H) h = io::getBv(i);
+    pk.H = h_from_dense(Hd, pk.prm.m_bits);
     pk.ubk.perm.resize(io::get64(i));
     for (auto& v : pk.ubk.perm) v = io::get32(i);
     pk.ubk.inv.resize(io::get64(i));
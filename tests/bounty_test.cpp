@@ -25,6 +25,7 @@ namespace Magic {
     constexpr uint32_t SK  = 0x66666999; // 6666-999 secret key
     constexpr uint32_t PK  = 0x06660666; // 0666-0666 public key
     constexpr uint32_t VER = 1; // format ver
+    constexpr uint32_t PK_VER = 2; // pk with prg_ver, a VER pk is prg v1
 }
 
 namespace io {
@@ -196,7 +197,7 @@ auto savePk = [](const PubKey& pk, const std::string& path) {
 
     std::ofstream o(path, std::ios::binary);
     io::put32(o, Magic::PK);
-    io::put32(o, Magic::VER);
+    io::put32(o, Magic::PK_VER);
     io::put32(o, pk.prm.m_bits);
     io::put32(o, pk.prm.B);
     io::put32(o, pk.prm.lpn_t);
@@ -207,13 +208,14 @@ auto savePk = [](const PubKey& pk, const std::string& path) {
     io::put32(o, (uint32_t)pk.prm.depth_slope_bits);
     io::put64(o, pk.prm.tuple2_fraction);
     io::put32(o, pk.prm.edge_budget);
+    io::put32(o, (uint32_t)pk.prm.prg_ver);
     io::put64(o, pk.canon_tag);
 
 
     o.write(reinterpret_cast<const char*>(pk.H_digest.data()), 32);
     io::put64(o, pk.H.size());
 
-    for (const auto& h : pk.H) io::putBv(o, h);
+    for (const auto& h : h_to_dense(pk.H)) io::putBv(o, h);
     io::put64(o, pk.ubk.perm.size());
 
     for (auto v : pk.ubk.perm) io::put32(o, v);
@@ -229,7 +231,8 @@ auto savePk = [](const PubKey& pk, const std::string& path) {
 
 auto loadPk = [](const std::string& path) -> PubKey {
     std::ifstream i(path, std::ios::binary);
-    if (io::get32(i) != Magic::PK || io::get32(i) != Magic::VER)
+    uint32_t ver = 0;
+    if (io::get32(i) != Magic::PK || ((ver = io::get32(i)) != Magic::VER && ver != Magic::PK_VER))
         throw std::runtime_error("bad pk header");
 
 
@@ -246,6 +249,8 @@ auto loadPk = [](const std::string& path) -> PubKey {
     pk.prm.depth_slope_bits = io::get32(i);
     pk.prm.tuple2_fraction = io::get64(i);
     pk.prm.edge_budget = io::get32(i);
+    // v1 files predate prg v2: their H and sigmas come from the sha256 stream
+    pk.prm.prg_ver = ver >= Magic::PK_VER ? (int)io::get32(i) : 1;
     pk.canon_tag = io::get64(i);
 
 
@@ -253,9 +258,11 @@ auto loadPk = [](const std::string& path) -> PubKey {
 
 //
     i.read(reinterpret_cast<char*>(pk.H_digest.data()), 32);
-    pk.H.resize(io::get64(i));
+    std::vector<BitVec> Hd(io::get64(i));
+
+    for (auto& h : Hd) h = io::getBv(i);
 
-    for (auto& h : pk.H) h = io::getBv(i);
+    pk.H = h_from_dense(Hd, pk.prm.m_bits);
     pk.ubk.perm.resize(io::get64(i));
 
     for (auto& v : pk.ubk.perm) v = io::get32(i);
@@ -27,6 +27,7 @@ namespace Magic {
     constexpr uint32_t SK  = 0x66666999;
     constexpr uint32_t PK  = 0x06660666;
     constexpr uint32_t VER = 1;
+    constexpr uint32_t PK_VER = 2; // pk with prg_ver, a VER pk is prg v1
 }
 
 namespace io {
@@ -123,7 +124,7 @@ auto loadPk = [](const std::string& path) -> PubKey {
     if (!i) throw std::runtime_error("cannot open " + path);
     auto magic = io::get32(i);
      auto ver = io::get32(i);
-    if (magic != Magic::PK || ver != Magic::VER)
+    if (magic != Magic::PK || (ver != Magic::VER && ver != Magic::PK_VER))
         throw std::runtime_error("bad pk header");
 
 
@@ -140,12 +141,16 @@ auto loadPk = [](const std::string& path) -> PubKey {
     pk.prm.depth_slope_bits = io::get32(i);
     pk.prm.tuple2_fraction = io::get64(i);
     pk.prm.edge_budget = io::get32(i);
+    // v1 files predate prg v2: their H and sigmas come from the sha256 stream
+    pk.prm.prg_ver = ver >= Magic::PK_VER ? (int)io::get32(i) : 1;
     pk.canon_tag = io::get64(i);
 
     i.read(reinterpret_cast<char*>(pk.H_digest.data()), 32);
-    pk.H.resize(io::get64(i));
+    std::vector<BitVec> Hd(io::get64(i));
 
-    for (auto& h : pk.H) h = io::getBv(i);
+    for (auto& h : Hd) h = io::getBv(i);
+
+    pk.H = h_from_dense(Hd, pk.prm.m_bits);
     pk.ubk.perm.resize(io::get64(i));
 
     for (auto& v : pk.ubk.perm) v = io::get32(i);
@@ -4,6 +4,7 @@
 #include <cstring>
 #include <cassert>
 #include <iostream>
+#include <vector>
 
 using namespace pvac;
 
@@ -74,6 +75,87 @@ int main() {
     }
     std::cout << "bounded: ok\n";
 
+    // bulk paths against the scalar stream, odd offsets and ragged tails
+    std::vector<uint64_t> ref(4096 + 64);
+    for (int impl = 1; impl <= 3; ++impl) {
+        if (!aes_ctr_has_impl(impl)) continue;
+        g_aes_impl = impl;
+        for (size_t skip : {0, 1, 3}) {
+            for (size_t n : {0, 1, 2, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 1000, 4096}) {
+                prg.init(key, 7);
+                for (size_t i = 0; i < skip + n; ++i) ref[i] = prg.next_u64();
+                uint64_t after = prg.next_u64();
+
+                std::vector<uint64_t> got(n);
+                prg.init(key, 7);
+                for (size_t i = 0; i < skip; ++i) (void)prg.next_u64();
+                prg.fill_u64(got.data(), n);
+                assert(std::memcmp(got.data(), ref.data() + skip, n * 8) == 0);
+                assert(prg.next_u64() == after);
+            }
+        }
+    }
+    select_aes_ctr();
+    std::cout << "bulk fill (impl " << g_aes_impl << " native): ok\n";
+
+    // fused and-xor against fill_u64 + and, both row alignments
+    std::vector<uint64_t> sec(1001), w(1001);
+    for (size_t i = 0; i < sec.size(); ++i) sec[i] = 0x9e3779b97f4a7c15ull * (i + 1) ^ (i << 7);
+    for (int impl = 1; impl <= 3; ++impl) {
+        if (!aes_ctr_has_impl(impl)) continue;
+        g_aes_impl = impl;
+        for (size_t skip : {0, 1}) {
+            for (size_t n : {0, 1, 2, 3, 16, 17, 31, 32, 33, 64, 65, 1001}) {
+                prg.init(key, 9);
+                for (size_t i = 0; i < skip; ++i) (void)prg.next_u64();
+                prg.fill_u64(w.data(), n);
+                uint64_t want = 0;
+                for (size_t i = 0; i < n; ++i) want ^= w[i] & sec[i];
+                uint64_t after = prg.next_u64();
+
+                prg.init(key, 9);
+                for (size_t i = 0; i < skip; ++i) (void)prg.next_u64();
+                assert(prg.and_xor_u64(sec.data(), n) == want);
+                assert(prg.next_u64() == after);
+            }
+        }
+        std::cout << "and_xor (impl " << impl << "): ok\n";
+    }
+
+    // lanes in step against one stream at a time: every lane count, both
+    // phases, and one lane a word ahead so the rows split
+    for (int impl = 1; impl <= 3; ++impl) {
+        if (!aes_ctr_has_impl(impl)) continue;
+        g_aes_impl = impl;
+        for (size_t nl = 1; nl <= 8; ++nl) {
+            for (int phase : {0, 1, 2}) {
+                AesCtr256 a[8], b[8];
+                AesCtr256* pa[8];
+                for (size_t l = 0; l < nl; ++l) {
+                    uint8_t kl[32];
+                    std::memcpy(kl, key, 32);
+                    kl[0] ^= (uint8_t)l;
+                    a[l].init(kl, 11 + l);
+                    b[l].init(kl, 11 + l);
+                    size_t skip = phase == 1 || (phase == 2 && l == nl - 1) ? 1 : 0;
+                    for (size_t i = 0; i < skip; ++i) (void)a[l].next_u64(), (void)b[l].next_u64();
+                    pa[l] = &a[l];
+                }
+
+                AesCtrLanes ln;
+                ln.init(pa, nl);
+                uint64_t x[8];
+                for (size_t n : {64, 65, 33, 1001, 0, 2}) {
+                    ln.and_xor(sec.data(), n, x);
+                    for (size_t l = 0; l < nl; ++l) assert(x[l] == b[l].and_xor_u64(sec.data(), n));
+                }
+                for (size_t l = 0; l < nl; ++l) assert(a[l].next_u64() == b[l].next_u64());
+            }
+        }
+        std::cout << "and_xor lanes (impl " << impl << "): ok\n";
+    }
+    select_aes_ctr();
+
     std::cout << "PASS\n";
 #else
     std::cout << "skipped (no AES-NI)\n";
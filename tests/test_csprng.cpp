@@ -0,0 +1,115 @@
+#include <pvac/pvac.hpp>
+
+#include <thread>
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace pvac;
+
+int main() {
+    std::cout << "- csprng test -\n";
+
+    {
+        const int N = 200000;
+        std::unordered_set<uint64_t> S;
+        S.reserve(N * 2);
+        uint64_t ones = 0;
+        for (int i = 0; i < N; i++) {
+            uint64_t x = csprng_u64();
+            ones += (uint64_t)__builtin_popcountll(x);
+            assert(S.insert(x).second);
+        }
+        double bal = (double)ones / (64.0 * N);
+        assert(bal > 0.49 && bal < 0.51);
+        std::cout << "u64 distinct, bal = " << bal << ": ok\n";
+    }
+
+    {
+        // buffered head, direct bulk pass and small tails all distinct
+        std::unordered_set<uint64_t> S;
+        (void)csprng_u64();
+        for (size_t n : {0, 1, 7, 255, 256, 300, 5000}) {
+            std::vector<uint64_t> v(n);
+            csprng_fill_u64(v.data(), n);
+            for (auto x : v) assert(S.insert(x).second);
+            assert(S.insert(csprng_u64()).second);
+        }
+        std::cout << "fill_u64: ok\n";
+    }
+
+    {
+        // past the reseed threshold
+        std::vector<uint64_t> v(CSPRNG_RESEED_BYTES / 8 + 1000);
+        csprng_fill_u64(v.data(), v.size());
+        uint64_t a = csprng_u64();
+        uint64_t b = csprng_u64();
+        assert(a != b && a != v.back());
+        std::cout << "reseed: ok\n";
+    }
+
+    {
+        const int T = 4;
+        const int N = 5000;
+        std::vector<std::vector<uint64_t>> out(T);
+        std::vector<std::thread> th;
+        for (int t = 0; t < T; t++) {
+            th.emplace_back([&, t] {
+                for (int i = 0; i < N; i++) out[t].push_back(csprng_u64());
+            });
+        }
+        for (auto& x : th) x.join();
+
+        std::unordered_set<uint64_t> S;
+        for (auto& v : out) {
+            for (auto x : v) assert(S.insert(x).second);
+        }
+        std::cout << "threads: ok\n";
+    }
+
+    {
+        // a forked child must not replay the parent's buffered words
+        (void)csprng_u64();
+
+        int fd[2];
+        assert(pipe(fd) == 0);
+        pid_t pid = fork();
+        assert(pid >= 0);
+
+        if (pid == 0) {
+            uint64_t w[4];
+            for (auto& x : w) x = csprng_u64();
+            ssize_t r = write(fd[1], w, sizeof(w));
+            _exit(r == (ssize_t)sizeof(w) ? 0 : 1);
+        }
+
+        uint64_t mine[4];
+        for (auto& x : mine) x = csprng_u64();
+
+        uint64_t theirs[4];
+        size_t got = 0;
+        while (got < sizeof(theirs)) {
+            ssize_t r = read(fd[0], (uint8_t*)theirs + got, sizeof(theirs) - got);
+            assert(r > 0);
+            got += (size_t)r;
+        }
+        int st = 0;
+        waitpid(pid, &st, 0);
+        assert(WIFEXITED(st) && WEXITSTATUS(st) == 0);
+
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) assert(mine[i] != theirs[j]);
+        }
+        close(fd[0]);
+        close(fd[1]);
+        std::cout << "fork: ok\n";
+    }
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <pvac/pvac.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <cassert>
+
+using namespace pvac;
+
+static void set_byte(const std::string & path, size_t off, char c) {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp((std::streamoff)off);
+    f.write(&c, 1);
+}
+
+static size_t file_size(const std::string & path) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    return (size_t)f.tellg();
+}
+
+static bool fp_eq(const Fp & a, const Fp & b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+int main() {
+    std::cout << "- ct file test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    PubKey lpk = pk;
+    lpk.prm.lazy_sigma = true;
+
+    // full, lazy, product and merged ciphers in one file
+    std::vector<Cipher> cs;
+    std::vector<uint64_t> want = { 5, 11, 30, 16 };
+    cs.push_back(enc_value(pk, sk, 5));
+    cs.push_back(enc_value(lpk, sk, 11));
+    cs.push_back(ct_mul(lpk, cs[0], enc_value(lpk, sk, 6)));
+    cs.push_back(ct_add(pk, cs[0], cs[1]));
+
+    const std::string path = "ct_file_test.bin";
+    assert(ct_file_save(path, pk, cs));
+
+    {
+        CtFile f;
+        assert(f.open(path, pk));
+        assert(f.size() == cs.size());
+
+        std::vector<Fp> got = dec_values(pk, sk, f.cts.data(), f.size());
+
+        for (size_t i = 0; i < cs.size(); i++) {
+            const CipherView & v = f[i];
+            assert(v.L.size() == cs[i].L.size() && v.E.size() == cs[i].E.size());
+            assert(fp_eq(got[i], fp_from_u64(want[i])));
+            assert(fp_eq(dec_value(pk, sk, v), fp_from_u64(want[i])));
+            assert(commit_ct(pk, v) == commit_ct(pk, cs[i]));
+
+            Cipher c = ct_load(v);
+            for (size_t k = 0; k < c.E.size(); k++) {
+                const Edge & x = c.E[k];
+                const Edge & y = cs[i].E[k];
+                assert(x.layer_id == y.layer_id && x.idx == y.idx && x.ch == y.ch);
+                assert(fp_eq(x.w, y.w) && x.salt == y.salt && x.salted == y.salted);
+                assert(x.s.nbits == y.s.nbits && x.s.w == y.s.w);
+            }
+        }
+
+        Cipher s = ct_add(pk, f[0], f[1]);
+        assert(fp_eq(dec_value(pk, sk, s), fp_from_u64(16)));
+        assert(commit_ct(pk, s) == commit_ct(pk, ct_add(pk, cs[0], cs[1])));
+        std::cout << "views: ok\n";
+    }
+
+    {
+        // the same ciphers with every sigma kept vs stripped to salts
+        std::vector<Cipher> full = cs, lazy = cs;
+        for (auto & c : full) ct_expand_sigma(pk, c);
+        for (auto & c : lazy) ct_strip_sigma(c);
+
+        assert(ct_file_save(path, pk, full));
+        size_t nf = file_size(path);
+        assert(ct_file_save(path, pk, lazy));
+        size_t nl = file_size(path);
+        std::cout << "file bytes " << nf << " -> " << nl << " (" << (double)nf / nl << "x)\n";
+
+        CtFile f;
+        assert(f.open(path, pk));
+        for (size_t i = 0; i < cs.size(); i++) {
+            assert(commit_ct(pk, f[i]) == commit_ct(pk, cs[i]));
+        }
+    }
+
+    {
+        // wrong key shape, bad records and short files are all rejected
+        assert(ct_file_save(path, pk, cs));
+        size_t sz = file_size(path);
+
+        PubKey other = pk;
+        other.prm.B = pk.prm.B + 1;
+        CtFile f;
+        assert(!f.open(path, other));
+
+        size_t l0 = 40 + 24 * cs.size();
+        size_t e0 = l0 + 40 * cs[0].L.size();
+
+        struct Hit { size_t off; char c; };
+        for (Hit h : { Hit{ 0, 'X' }, Hit{ l0, 7 }, Hit{ e0 + 3, 0x7f }, Hit{ e0 + 5, 0x7f },
+                       Hit{ e0 + 6, 2 }, Hit{ e0 + 7, 0 }, Hit{ e0 + 39, 0x40 } }) {
+            assert(ct_file_save(path, pk, cs));
+            set_byte(path, h.off, h.c);
+            assert(!f.open(path, pk));
+        }
+
+        assert(ct_file_save(path, pk, cs));
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> b(sz - 8);
+        in.read(b.data(), (std::streamsize)b.size());
+        in.close();
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(b.data(), (std::streamsize)b.size());
+        }
+        assert(!f.open(path, pk));
+        assert(!f.open("ct_file_missing.bin", pk));
+
+        Cipher bad = cs[0];
+        bad.E[0].s = BitVec {};
+        bad.E[0].salted = false;
+        assert(!ct_file_save(path, pk, &bad, 1));
+
+        // a PROD cycle: the product layer becomes a parent of its own parent
+        Cipher cyc = cs[2];
+        uint32_t p = (uint32_t)cyc.L.size() - 1;
+        assert(cyc.L[p].rule == RRule::PROD);
+        Layer & q = cyc.L[cyc.L[p].pa];
+        q.rule = RRule::PROD;
+        q.pa = q.pb = p;
+        assert(ct_file_save(path, pk, &cyc, 1));
+        assert(!f.open(path, pk));
+        std::cout << "corruption rejected: ok\n";
+    }
+
+    std::remove(path.c_str());
+    std::cout << "\nresult: PASS\n";
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include <pvac/pvac.hpp>
 
 #include <vector>
+#include <chrono>
+#include <algorithm>
 #include <random>
 #include <cstdint>
 #include <cassert>
@@ -87,6 +89,214 @@ int main() {
         }
     }
 
+    {
+        // ct_mul weights and edge order do not depend on the worker count,
+        // only the sigma salts and layer nonces are fresh per call
+        int nt = get_threads();
+        set_threads(1);
+        Cipher m1 = ct_mul(pk, enc[0], enc[1]);
+        set_threads(4);
+        Cipher m4 = ct_mul(pk, enc[0], enc[1]);
+        set_threads(nt);
+
+        assert(m1.L.size() == m4.L.size() && m1.E.size() == m4.E.size());
+        for (size_t i = 0; i < m1.E.size(); ++i) {
+            const Edge& x = m1.E[i];
+            const Edge& y = m4.E[i];
+            assert(x.layer_id == y.layer_id && x.idx == y.idx && x.ch == y.ch);
+            assert(fp_eq(x.w, y.w) && x.s.nbits == y.s.nbits);
+        }
+
+        Fp want = fp_mul(fp_from_u64(vals[0]), fp_from_u64(vals[1]));
+        assert(fp_eq(dec_value(pk, sk, m1), want));
+        assert(fp_eq(dec_value(pk, sk, m4), want));
+        std::cout << "ct_mul 1 vs 4 threads: ok\n";
+    }
+
+    {
+        // long PROD chain stored back to front: L[N-1] is the BASE layer,
+        // L[i] = L[i + 1] * L[N-1], so kahn has to reorder all of it
+        const uint32_t N = 200000;
+        Cipher ch;
+        ch.L.resize(N);
+        ch.L[N - 1] = enc[0].L[0];
+        for (uint32_t i = 0; i + 1 < N; ++i) {
+            ch.L[i].rule = RRule::PROD;
+            ch.L[i].pa = i + 1;
+            ch.L[i].pb = N - 1;
+        }
+
+        Fp w = fp_from_u64(77);
+        ch.E.push_back(Edge{0, 3, SGN_P, w, BitVec::make(prm.m_bits)});
+
+        auto order = layer_topo_order(ch);
+        assert(order.size() == N && order[0] == N - 1 && order[N - 1] == 0);
+
+        std::vector<Fp> R = layer_R_all(pk, sk, ch);
+        Fp r0 = prf_R(pk, sk, ch.L[N - 1].seed);
+        assert(fp_eq(R[N - 1], r0));
+        assert(fp_eq(R[0], fp_pow_u64(r0, N)));
+
+        Fp want = fp_mul(fp_mul(w, pk.powg_B[3]), fp_inv(R[0]));
+        assert(fp_eq(dec_value(pk, sk, ch), want));
+
+        // only the chain is live, compaction keeps it whole
+        Cipher cc = ch;
+        cc.L.push_back(enc[1].L[0]);
+        compact_layers(cc);
+        assert(cc.L.size() == N);
+        assert(fp_eq(dec_value(pk, sk, cc), want));
+        std::cout << "topo chain: ok\n";
+    }
+
+    {
+        // running sums: in place and by move against the copying ct_add
+        const int N = 120;
+        std::vector<Cipher> xs;
+        uint64_t sum = 0;
+        for (int i = 0; i < N; ++i) {
+            xs.push_back(enc_value(pk, sk, (uint64_t)i + 1));
+            sum += (uint64_t)i + 1;
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        Cipher ref = xs[0];
+        for (int i = 1; i < N; ++i) ref = ct_add(pk, ref, xs[i]);
+        auto t1 = std::chrono::steady_clock::now();
+        Cipher acc = xs[0];
+        for (int i = 1; i < N; ++i) ct_add_inplace(pk, acc, xs[i]);
+        auto t2 = std::chrono::steady_clock::now();
+
+        assert(commit_ct(pk, acc) == commit_ct(pk, ref));
+        assert(fp_eq(dec_value(pk, sk, acc), fp_from_u64(sum)));
+        std::cout << "sum of " << N << ": ct_add "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, inplace "
+                  << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms\n";
+
+        t0 = std::chrono::steady_clock::now();
+        Cipher sm = ct_sum(pk, xs);
+        t1 = std::chrono::steady_clock::now();
+        assert(commit_ct(pk, sm) == commit_ct(pk, ref));
+        std::cout << "ct_sum of " << N << ": "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms\n";
+
+        // dead layers of an input are dropped as ct_add does
+        std::vector<Cipher> two = { xs[0], xs[1] };
+        two[0].L.push_back(xs[2].L[0]);
+        assert(commit_ct(pk, ct_sum(pk, two)) == commit_ct(pk, ct_add(pk, two[0], two[1])));
+
+        assert(ct_sum(pk, xs.data(), 0).E.empty());
+        assert(commit_ct(pk, ct_sum(pk, xs.data() + 7, 1)) == commit_ct(pk, xs[7]));
+
+        // rvalue overloads steal the edges of their operands
+        Cipher mv = xs[0];
+        for (int i = 1; i < N; ++i) {
+            Cipher t = xs[i];
+            mv = ct_add(pk, std::move(mv), std::move(t));
+            assert(t.E.empty());
+        }
+        assert(commit_ct(pk, mv) == commit_ct(pk, ref));
+
+        // sub, neg and scale in all operand forms agree
+        Fp k = fp_from_u64(7);
+        Cipher d0 = ct_sub(pk, xs[5], xs[2]);
+        Cipher d1 = ct_sub(pk, Cipher(xs[5]), xs[2]);
+        Cipher d2 = ct_sub(pk, xs[5], Cipher(xs[2]));
+        Cipher d3 = xs[5];
+        ct_sub_inplace(pk, d3, Cipher(xs[2]));
+        Cipher d4 = ct_add(pk, xs[5], ct_neg(pk, xs[2]));
+        for (const Cipher* d : { &d1, &d2, &d3, &d4 }) assert(commit_ct(pk, *d) == commit_ct(pk, d0));
+        assert(fp_eq(dec_value(pk, sk, d0), fp_from_u64(3)));
+
+        Cipher s0 = ct_scale(pk, xs[3], k);
+        Cipher s1 = ct_scale(pk, Cipher(xs[3]), k);
+        assert(commit_ct(pk, s0) == commit_ct(pk, s1));
+        assert(fp_eq(dec_value(pk, sk, s1), fp_from_u64(28)));
+
+        // self aliasing doubles
+        Cipher self = xs[4];
+        ct_add_inplace(pk, self, self);
+        assert(fp_eq(dec_value(pk, sk, self), fp_from_u64(10)));
+        ct_sub_inplace(pk, self, self);
+        assert(fp_eq(dec_value(pk, sk, self), fp_from_u64(0)));
+        std::cout << "inplace / move: ok\n";
+    }
+
+    {
+        // compact_edges: every slot ends up with one edge, in key order,
+        // cancelling slots vanish and the value is kept
+        Cipher c = ct_add(pk, enc[0], enc[1]);
+        size_t n0 = c.E.size();
+        for (size_t i = 0; i < n0; i += 3) {
+            Edge d = c.E[i];
+            d.w = fp_from_u64(5);
+            c.E.push_back(d);
+        }
+        auto key = [](const Edge& e) {
+            return ((uint64_t)e.layer_id << 17) | ((uint64_t)e.idx << 1) | e.ch;
+        };
+
+        // the slot of E[1] cancels out unless it had company already
+        std::vector<uint64_t> slots;
+        size_t with1 = 0;
+        for (const auto& e : c.E) {
+            slots.push_back(key(e));
+            with1 += key(e) == key(c.E[1]);
+        }
+        std::sort(slots.begin(), slots.end());
+        size_t expect = (size_t)(std::unique(slots.begin(), slots.end()) - slots.begin()) - (with1 == 1);
+
+        Edge gone = c.E[1];
+        gone.w = fp_neg(gone.w);
+        c.E.push_back(gone);
+        Fp want = dec_value(pk, sk, c);
+
+        int nt = get_threads();
+        set_threads(1);
+        Cipher c1 = c;
+        compact_edges(pk, c1);
+        set_threads(4);
+        Cipher c4 = c;
+        compact_edges(pk, c4);
+        set_threads(nt);
+
+        assert(commit_ct(pk, c1) == commit_ct(pk, c4));
+        assert(fp_eq(dec_value(pk, sk, c1), want));
+        for (size_t i = 1; i < c1.E.size(); ++i) assert(key(c1.E[i - 1]) < key(c1.E[i]));
+        assert(c1.E.size() == expect);
+
+        // lone edges get the same zero test, a lazy one on its weight
+        Cipher z = c1;
+        z.L.push_back(enc[0].L[0]);
+        uint32_t lz = (uint32_t)z.L.size() - 1;
+        z.E.push_back({lz, 0, SGN_P, fp_from_u64(0), BitVec::make(pk.prm.m_bits), 0, false});
+        z.E.push_back({lz, 1, SGN_P, fp_from_u64(0), BitVec{}, 7, true});
+        z.E.push_back({lz, 2, SGN_P, fp_from_u64(1), BitVec::make(pk.prm.m_bits), 0, false});
+        compact_edges(pk, z);
+        assert(z.E.size() == c1.E.size() + 1 && z.E.back().idx == 2);
+
+        // 10k layers, where the slot table used to be L * B entries
+        Cipher big;
+        const uint32_t NL = 10000;
+        for (uint32_t l = 0; l < NL; ++l) {
+            big.L.push_back(enc[l % K].L[0]);
+            for (int j = 0; j < 4; ++j) {
+                const Edge& src = enc[l % K].E[j % 2];
+                Edge e = src;
+                e.layer_id = l;
+                big.E.push_back(std::move(e));
+            }
+        }
+        set_threads(4);
+        auto t0 = std::chrono::steady_clock::now();
+        compact_edges(pk, big);
+        auto t1 = std::chrono::steady_clock::now();
+        set_threads(nt);
+        assert(big.E.size() <= 2 * (size_t)NL);
+        std::cout << "compact " << NL << " layers: "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms\n";
+    }
+
     std::cout << "ct-fuzz: ok\n";
     std::cout << "PASS\n";
     return 0;
@@ -0,0 +1,142 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <cassert>
+
+using namespace pvac;
+
+static bool fp_eq(const Fp & a, const Fp & b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+template <class F>
+static double best_ms(int reps, F && f) {
+    double best = 1e300;
+    for (int r = 0; r < reps; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+int main() {
+    std::cout << "- soa cipher test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 3);
+    Cipher b = enc_value(pk, sk, 5);
+    Cipher p = ct_mul(pk, a, b);
+
+    // a wide cipher: the product plus copies of a and b, lazy edges in
+    // the mix so the expansion on the way in is covered too
+    PubKey lpk = pk;
+    lpk.prm.lazy_sigma = true;
+    Cipher C = ct_add(pk, p, enc_value(lpk, sk, 4));
+    for (int i = 0; i < 6; i++) C = ct_add(pk, C, i % 2 ? a : b);
+
+    const Fp want = fp_from_u64(15 + 4 + 3 * 3 + 3 * 5);
+    assert(fp_eq(dec_value(pk, sk, C), want));
+
+    CipherSoA S = ct_to_soa(pk, C);
+    assert(S.E.size() == C.E.size() && S.wpe % 8 == 0);
+    assert(((uintptr_t)S.sig.data() & 63) == 0);
+    assert(fp_eq(dec_value(pk, sk, S), want));
+    assert(commit_ct(pk, S) == commit_ct(pk, C));
+    assert(commit_ct(pk, ct_from_soa(S)) == commit_ct(pk, C));
+    std::cout << C.E.size() << " edges, round trip: ok\n";
+
+    {
+        double d0 = sigma_density(pk, C), d1 = sigma_density(pk, S);
+        assert(d0 == d1);
+
+        Cipher Ce = C;
+        ct_expand_sigma(pk, Ce);
+
+        double t0 = best_ms(20, [&] { d0 += sigma_density(pk, Ce); });
+        double t1 = best_ms(20, [&] { d1 += sigma_density(pk, S); });
+        volatile double sink = d0 + d1;
+        (void)sink;
+        std::cout << "sigma_density: " << t0 << " ms -> " << t1 << " ms (" << t0 / t1 << "x)\n";
+    }
+
+    {
+        double t0 = best_ms(5, [&] { commit_ct(pk, C); });
+        double t1 = best_ms(5, [&] { commit_ct(pk, S); });
+        std::cout << "commit_ct: " << t0 << " ms -> " << t1 << " ms (" << t0 / t1 << "x)\n";
+    }
+
+    {
+        Cipher X = C;
+        CipherSoA Y = S;
+        ubk_apply(pk, X);
+        ubk_apply(pk, Y);
+        assert(commit_ct(pk, X) == commit_ct(pk, Y));
+
+        double t0 = best_ms(3, [&] { ubk_apply(pk, X); });
+        double t1 = best_ms(3, [&] { ubk_apply(pk, Y); });
+        assert(commit_ct(pk, X) == commit_ct(pk, Y));
+        std::cout << "ubk_apply: " << t0 << " ms -> " << t1 << " ms (" << t0 / t1 << "x)\n";
+    }
+
+    {
+        CipherSoA Y = S;
+        assert(ct_add_inplace(pk, Y, S));
+        assert(fp_eq(dec_value(pk, sk, Y), fp_add(want, want)));
+
+        // dead layers of b are dropped as the Cipher form drops them
+        Cipher D = a;
+        Layer dead = D.L[0];
+        dead.seed.nonce.lo ^= 1;
+        D.L.insert(D.L.begin(), dead);
+        for (auto & e : D.E) e.layer_id++;
+        Cipher Xa = b;
+        CipherSoA Ya = ct_to_soa(pk, b);
+        ct_add_inplace(pk, Xa, D);
+        assert(ct_add_inplace(pk, Ya, ct_to_soa(pk, D)));
+        assert(Ya.L.size() == Xa.L.size() && Ya.L.size() == b.L.size() + a.L.size());
+        assert(commit_ct(pk, Ya) == commit_ct(pk, Xa));
+        assert(fp_eq(dec_value(pk, sk, Ya), fp_from_u64(8)));
+
+        // a slab of another width is refused and acc left as it was
+        CipherSoA Z = S;
+        Z.m_bits = S.m_bits / 2;
+        Z.wpe = soa_wpe(Z.m_bits);
+        size_t n0 = Y.E.size(), l0 = Y.L.size();
+        assert(!ct_add_inplace(pk, Y, Z));
+        assert(Y.E.size() == n0 && Y.L.size() == l0);
+
+        // every edge twice in its own layer: each pair merges into one
+        // edge of twice the weight and an all zero sigma
+        Cipher X = C;
+        X.E.insert(X.E.end(), C.E.begin(), C.E.end());
+
+        Cipher Xc = X;
+        CipherSoA Yc = ct_to_soa(pk, X);
+        double t0 = best_ms(1, [&] { compact_edges(pk, Xc); });
+        double t1 = best_ms(1, [&] { compact_edges(pk, Yc); });
+
+        assert(Yc.E.size() == Xc.E.size() && Yc.E.size() < X.E.size());
+        assert(commit_ct(pk, Yc) == commit_ct(pk, Xc));
+        assert(fp_eq(dec_value(pk, sk, Yc), fp_add(want, want)));
+        std::cout << "compact_edges: " << t0 << " ms -> " << t1 << " ms (" << t0 / t1 << "x), "
+                  << X.E.size() << " -> " << Yc.E.size() << " edges\n";
+
+        // a lone edge of zero weight and zero sigma goes in both forms
+        Cipher Z1 = Xc;
+        Z1.L.push_back(a.L[0]);
+        Z1.E.push_back({(uint32_t)Z1.L.size() - 1, 0, SGN_M, fp_from_u64(0), BitVec::make(pk.prm.m_bits), 0, false});
+        CipherSoA Z2 = ct_to_soa(pk, Z1);
+        compact_edges(pk, Z1);
+        compact_edges(pk, Z2);
+        assert(Z1.E.size() == Xc.E.size() && Z2.E.size() == Xc.E.size());
+    }
+
+    std::cout << "\nresult: PASS\n";
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <pvac/pvac.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <cassert>
+
+using namespace pvac;
+
+static void set_byte(const std::string & path, size_t off, char c) {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp((std::streamoff)off);
+    f.write(&c, 1);
+}
+
+static bool fp_eq(const Fp & a, const Fp & b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+int main() {
+    std::cout << "- ct stream test -\n";
+
+    // rfc 3720 check value, split to cover the byte tail
+    const uint8_t* chk = (const uint8_t*)"123456789";
+    assert(crc32c(chk, 9) == 0xE3069283u);
+    assert(crc32c(chk + 5, 4, crc32c(chk, 5)) == 0xE3069283u);
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    PubKey lpk = pk;
+    lpk.prm.lazy_sigma = true;
+
+    const size_t N = 40;
+    std::vector<Cipher> cs;
+    std::vector<std::array<uint8_t, 32>> com;
+
+    for (size_t i = 0; i < N; i++) {
+        cs.push_back(enc_value(i % 2 ? lpk : pk, sk, 1000 + i));
+        com.push_back(commit_ct(pk, cs[i]));
+    }
+
+    const std::string path = "ct_stream_test.bin";
+    {
+        CtArchiveWriter w;
+        assert(w.open(path, pk));
+        for (const auto & c : cs) assert(w.put(c));
+        assert(w.close());
+    }
+
+    {
+        // small chunks, so the scan crosses many read-ahead boundaries
+        CtArchiveReader rd;
+        rd.chunk_bytes = 64 << 10;
+        assert(rd.open(path, pk));
+        assert(rd.size() == N);
+
+        CtChunk c;
+        size_t seen = 0, chunks = 0;
+
+        while (rd.next(c)) {
+            assert(c.first == seen);
+            std::vector<Fp> got = dec_values(pk, sk, c.cts.data(), c.cts.size());
+
+            for (size_t k = 0; k < c.cts.size(); k++) {
+                assert(fp_eq(got[k], fp_from_u64(1000 + seen + k)));
+                assert(commit_ct(pk, c.cts[k]) == com[seen + k]);
+            }
+
+            seen += c.cts.size();
+            chunks++;
+        }
+
+        assert(seen == N && !rd.bad && chunks > 1);
+
+        Cipher x;
+        assert(rd.get(17, x) && commit_ct(pk, x) == com[17]);
+        assert(!rd.get(N, x));
+        std::cout << "iterate " << chunks << " chunks: ok\n";
+    }
+
+    {
+        std::vector<int> hit(N, 0);
+        std::atomic<size_t> good { 0 }, nested { 0 };
+
+        // with workers, the parallel_for inside dec_value runs inline on
+        // the scan worker instead of spawning threads of its own
+        int nt = get_threads();
+        set_threads(4);
+
+        auto t0 = std::chrono::steady_clock::now();
+        bool ok = ct_archive_scan(path, pk, [&](size_t i, const CipherView & v) {
+            hit[i]++;
+            if (fp_eq(dec_value(pk, sk, v), fp_from_u64(1000 + i))) good++;
+
+            std::thread::id me = std::this_thread::get_id();
+            parallel_for(64, 1, [&](size_t, size_t) {
+                if (std::this_thread::get_id() != me) nested++;
+            });
+        }, 128 << 10);
+        set_threads(nt);
+        assert(nested == 0);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        assert(ok && good == N);
+        for (int h : hit) assert(h == 1);
+        std::cout << "scan + dec: " << N / ms * 1000 << " ct/s\n";
+    }
+
+    {
+        // a flipped payload byte fails the crc, a flipped footer the open
+        CtArchiveReader rd;
+        assert(rd.open(path, pk));
+        size_t off = (size_t)rd.index[5];
+
+        set_byte(path, off + 8 + 100, 0x55);
+        assert(rd.open(path, pk));
+
+        CtChunk c;
+        size_t seen = 0;
+        while (rd.next(c)) seen += c.cts.size();
+        assert(rd.bad && seen < N);
+
+        Cipher x;
+        assert(!rd.get(5, x) && rd.get(4, x));
+
+        std::atomic<size_t> n { 0 };
+        assert(!ct_archive_scan(path, pk, [&](size_t, const CipherView &) { n++; }));
+
+        PubKey other = pk;
+        other.prm.m_bits = pk.prm.m_bits / 2;
+        assert(!rd.open(path, other));
+
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        size_t sz = (size_t)in.tellg();
+        in.close();
+        set_byte(path, sz - 1, 'x');
+        assert(!rd.open(path, pk));
+
+        // the u32 after B is reserved and must be 0
+        {
+            CtArchiveWriter w;
+            assert(w.open(path, pk) && w.put(cs[0]) && w.close());
+        }
+        assert(rd.open(path, pk));
+        set_byte(path, 20, 1);
+        assert(!rd.open(path, pk));
+
+        std::cout << "corruption rejected: ok\n";
+    }
+
+    {
+        // a writer dropped without close still writes the footer
+        {
+            CtArchiveWriter w;
+            assert(w.open(path, pk));
+            for (size_t i = 0; i < 3; i++) assert(w.put(cs[i]));
+        }
+
+        CtArchiveReader rd;
+        Cipher x;
+        assert(rd.open(path, pk) && rd.size() == 3);
+        assert(rd.get(2, x) && commit_ct(pk, x) == com[2]);
+        std::cout << "footer on destruction: ok\n";
+    }
+
+    std::remove(path.c_str());
+    std::cout << "\nresult: PASS\n";
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <pvac/pvac.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <iostream>
+#include <cassert>
+
+using namespace pvac;
+
+static bool fp_eq(const Fp & a, const Fp & b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+int main() {
+    std::cout << "- enc_values test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    std::vector<uint64_t> vs;
+    for (uint64_t i = 0; i < 24; i++) vs.push_back(i * 7919 + (i == 3 ? ~0ull : 0));
+
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (uint64_t v : vs) enc_value_depth(pk, sk, v, 1);
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "enc_value loop: " << vs.size() / s << " values/s\n";
+    }
+
+    for (int nt : { 1, 4 }) {
+        set_threads(nt);
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<Cipher> cs = enc_values(pk, sk, vs, 1);
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        assert(cs.size() == vs.size());
+        std::vector<Fp> got = dec_values(pk, sk, cs.data(), cs.size());
+        for (size_t i = 0; i < vs.size(); i++) assert(fp_eq(got[i], fp_from_u64(vs[i])));
+
+        size_t cores = std::min<size_t>((size_t)nt, std::max(1u, std::thread::hardware_concurrency()));
+        std::cout << "threads " << nt << ": " << vs.size() / s << " values/s, "
+                  << vs.size() / s / (double)cores << " values/s/core\n";
+    }
+
+    {
+        // parallel_for helpers persist across calls, so per thread scratch
+        // does too: the same threads run the second batch
+        int nt = get_threads();
+        set_threads(4);
+        std::mutex mu;
+        std::set<std::thread::id> a, b;
+        auto ids = [&](std::set<std::thread::id> & s) {
+            parallel_for(64, 1, [&](size_t, size_t) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                std::lock_guard<std::mutex> lk(mu);
+                s.insert(std::this_thread::get_id());
+            });
+        };
+        ids(a);
+        enc_values(pk, sk, vs.data(), 4, 0, std::vector<Cipher>(4).data());
+        ids(b);
+        assert(WorkerPool::get().size() == 3);
+        a.erase(std::this_thread::get_id());
+        b.erase(std::this_thread::get_id());
+        for (auto & id : b) assert(a.count(id));
+        set_threads(nt);
+    }
+
+    {
+        // the pointer form writes into a caller buffer, n = 0 is a no-op
+        std::vector<Cipher> out(3);
+        enc_values(pk, sk, vs.data(), 3, 0, out.data());
+        for (size_t i = 0; i < 3; i++) assert(fp_eq(dec_value(pk, sk, out[i]), fp_from_u64(vs[i])));
+        enc_values(pk, sk, vs.data(), 0, 0, out.data());
+        assert(enc_values(pk, sk, std::vector<uint64_t> {}, 0).empty());
+    }
+
+    {
+        // per thread scratch must not leak between prf calls of different sizes
+        RSeed sd;
+        sd.nonce = make_nonce128();
+        sd.ztag = prg_layer_ztag(pk.canon_tag, sd.nonce);
+        Fp a = prf_R(pk, sk, sd);
+        std::vector<Fp> b = prf_R_batch(pk, sk, { sd, sd, sd });
+        assert(fp_eq(a, b[0]) && fp_eq(a, b[2]) && fp_eq(a, prf_R(pk, sk, sd)));
+    }
+
+    std::cout << "\nresult: PASS\n";
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <cmath>
 #include <cassert>
 #include <iostream>
+#include <vector>
 
 using namespace pvac;
 
@@ -70,6 +71,17 @@ int main() {
     }
     std::cout << "inv: ok\n";
 
+    for (size_t n : {1, 2, 7, 300}) {
+        std::vector<Fp> v(n), w(n);
+        for (auto& x : v) x = rand_fp_nonzero();
+        w = v;
+        fp_batch_inv(w.data(), n);
+        for (size_t i = 0; i < n; ++i) {
+            assert(fp_eq(w[i], fp_inv(v[i])));
+        }
+    }
+    std::cout << "batch inv: ok\n";
+
     const u128 P = (((u128)1) << 127) - 1;
     const int N4 = 2000;
 
@@ -14,14 +14,9 @@ Adj build(const PubKey& pk) {
     int m = pk.prm.m_bits, n = pk.prm.n_bits;
     Adj a; a.ev.assign(n, {}); a.ve.assign(m, {});
     for (int c = 0; c < n; ++c) {
-        const BitVec& col = pk.H[c];
-        for (size_t wi = 0; wi < col.w.size(); ++wi) {
-            uint64_t x = col.w[wi];
-            while (x) {
-                int r = wi * 64 + __builtin_ctzll(x);
-                if (r < m) { a.ev[c].push_back(r); a.ve[r].push_back(c); }
-                x &= x - 1;
-            }
+        for (uint32_t k = pk.H.col_ptr[c]; k < pk.H.col_ptr[c + 1]; ++k) {
+            int r = pk.H.rows[k];
+            if (r < m) { a.ev[c].push_back(r); a.ve[r].push_back(c); }
         }
     }
     return a;
@@ -151,7 +146,24 @@ int main() {
     std::cout << "range = " << is.lo << " - " << is.hi << "\n";
     std::cout << "expected = " << ix << "\n\n";
 
-    bool ok = (nc == 1) && (std::abs(sv.mu - lam) < 5) && (std::abs(is.mu - ix) < 1);
+    // sparse form: dense round trip, sorted rows, memory vs dense columns
+    SparseH H2 = h_from_dense(h_to_dense(pk.H), m);
+    bool rt = H2.col_ptr == pk.H.col_ptr && H2.rows == pk.H.rows;
+    bool sorted = true;
+    for (int c = 0; c < n; ++c) {
+        for (uint32_t q = pk.H.col_ptr[c] + 1; q < pk.H.col_ptr[c + 1]; ++q) {
+            sorted = sorted && pk.H.rows[q - 1] < pk.H.rows[q];
+        }
+    }
+    size_t dense = (size_t)n * ((m + 63) / 64) * 8;
+
+    std::cout << "- sparse H -\n";
+    std::cout << "\n";
+
+    std::cout << "round trip = " << (rt ? "ok" : "FAIL") << ", sorted = " << (sorted ? "ok" : "FAIL") << "\n";
+    std::cout << "bytes = " << pk.H.bytes() << " (dense " << dense << ")\n\n";
+
+    bool ok = (nc == 1) && (std::abs(sv.mu - lam) < 5) && (std::abs(is.mu - ix) < 1) && rt && sorted;
     std::cout << (ok ? "PASS" : "FAIL") << "\n";
     return ok ? 0 : 1;
 }
\ No newline at end of file
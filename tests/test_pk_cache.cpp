@@ -0,0 +1,178 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <cassert>
+
+using namespace pvac;
+
+static double ms_since(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+static void flip_byte(const std::string & path, size_t off) {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekg((std::streamoff)off);
+    char c = 0;
+    f.read(&c, 1);
+    c ^= 0x01;
+    f.seekp((std::streamoff)off);
+    f.write(&c, 1);
+}
+
+static size_t file_size(const std::string & path) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    return (size_t)f.tellg();
+}
+
+int main() {
+    std::cout << "- pk cache test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+
+    auto t0 = std::chrono::steady_clock::now();
+    keygen(prm, pk, sk);
+    std::cout << "keygen (" << get_threads() << " threads): " << ms_since(t0) << " ms\n";
+
+    {
+        // H does not depend on the worker count
+        PubKey a, b;
+        a.prm = b.prm = prm;
+        a.canon_tag = b.canon_tag = pk.canon_tag;
+
+        int nt = get_threads();
+        set_threads(1);
+        gen_H(a);
+        set_threads(4);
+        gen_H(b);
+        set_threads(nt);
+
+        assert(a.H.col_ptr == pk.H.col_ptr && a.H.rows == pk.H.rows);
+        assert(b.H.col_ptr == pk.H.col_ptr && b.H.rows == pk.H.rows);
+        assert(a.H_digest == pk.H_digest && b.H_digest == pk.H_digest);
+        std::cout << "gen_H 1 vs 4 threads: ok\n";
+    }
+
+    const std::string path = "pk_cache_test.bin";
+    assert(pk_cache_save(pk, path));
+
+    {
+        PubKey q;
+        t0 = std::chrono::steady_clock::now();
+        assert(pk_cache_load(path, q, &pk.H_digest));
+        std::cout << "load + verify: " << ms_since(t0) << " ms, "
+                  << file_size(path) << " bytes\n";
+
+        assert(q.canon_tag == pk.canon_tag);
+        assert(q.H.col_ptr == pk.H.col_ptr && q.H.rows == pk.H.rows);
+        assert(q.ubk.perm == pk.ubk.perm && q.ubk.inv == pk.ubk.inv);
+        assert(q.omega_B.lo == pk.omega_B.lo && q.omega_B.hi == pk.omega_B.hi);
+        assert(q.powg_B.size() == pk.powg_B.size());
+        assert(q.prm.n_bits == prm.n_bits && q.prm.prg_ver == prm.prg_ver);
+
+        Fp x = fp_from_u64(12345);
+        Cipher c = enc_value(q, sk, 12345);
+        assert(ct::fp_eq(dec_value(pk, sk, c), x));
+        std::cout << "round trip + dec: ok\n";
+    }
+
+    {
+        // a trusted digest that differs is refused
+        auto bad = pk.H_digest;
+        bad[0] ^= 1;
+        PubKey q;
+        assert(!pk_cache_load(path, q, &bad));
+    }
+
+    {
+        // one flipped bit in H rows, ubk and powg_B, and a short file
+        size_t sz = file_size(path);
+        size_t h_rows = sz - 16 * pk.powg_B.size() - 4 - 16 - 8 * (size_t)prm.m_bits - 1000;
+        size_t ubk = sz - 16 * pk.powg_B.size() - 4 - 16 - 100;
+        size_t powg = sz - 40;
+
+        for (size_t off : { h_rows, ubk, powg }) {
+            assert(pk_cache_save(pk, path));
+            flip_byte(path, off);
+            PubKey q;
+            assert(!pk_cache_load(path, q));
+        }
+
+        assert(pk_cache_save(pk, path));
+        {
+            std::ofstream f(path, std::ios::binary | std::ios::app);
+            f.put(0);
+        }
+        PubKey q;
+        assert(!pk_cache_load(path, q));
+        assert(!pk_cache_load("pk_cache_missing.bin", q));
+        std::cout << "corruption rejected: ok\n";
+    }
+
+    {
+        // H edits the or-ed column digest cannot see: a repeated row with
+        // col_ptr shifted, and two rows of a column swapped
+        PubKey d = pk;
+        d.H.rows.insert(d.H.rows.begin() + 1, d.H.rows[0]);
+        for (size_t c = 1; c < d.H.col_ptr.size(); c++) d.H.col_ptr[c]++;
+        h_digest(d.prm, d.H, d.H_digest.data());
+        assert(d.H_digest == pk.H_digest);
+        assert(pk_cache_save(d, path));
+        PubKey q;
+        assert(!pk_cache_load(path, q, &pk.H_digest));
+
+        d = pk;
+        std::swap(d.H.rows[0], d.H.rows[1]);
+        h_digest(d.prm, d.H, d.H_digest.data());
+        assert(d.H_digest == pk.H_digest);
+        assert(pk_cache_save(d, path));
+        assert(!pk_cache_load(path, q, &pk.H_digest));
+
+        // params outside the digest: out of range always fails, a changed
+        // field fails against the params the caller expects
+        d = pk;
+        d.prm.prg_ver = 7;
+        assert(pk_cache_save(d, path));
+        assert(!pk_cache_load(path, q));
+
+        d = pk;
+        d.prm.lpn_t = pk.prm.lpn_t / 2;
+        assert(pk_cache_save(d, path));
+        assert(pk_cache_load(path, q, &pk.H_digest));
+        assert(!pk_cache_load(path, q, &pk.H_digest, &pk.prm));
+
+        assert(pk_cache_save(pk, path));
+        assert(pk_cache_load(path, q, &pk.H_digest, &pk.prm));
+        std::cout << "H rows and params checked: ok\n";
+    }
+
+    {
+        // concurrent writers of one path each rename their own temp file,
+        // so whichever lands last is a whole cache
+        std::vector<std::thread> ws;
+        bool ok[4] = {};
+        for (int t = 0; t < 4; t++) {
+            ws.emplace_back([&, t] {
+                for (int r = 0; r < 4; r++) ok[t] = pk_cache_save(pk, path);
+            });
+        }
+        for (auto& w : ws) w.join();
+        for (bool b : ok) assert(b);
+
+        PubKey q;
+        assert(pk_cache_load(path, q, &pk.H_digest, &pk.prm));
+
+        // a failed write leaves nothing behind
+        assert(!pk_cache_save(pk, "no_such_dir/pk.bin"));
+        std::cout << "concurrent saves: ok\n";
+    }
+
+    std::remove(path.c_str());
+    std::cout << "\nresult: PASS\n";
+    return 0;
+}
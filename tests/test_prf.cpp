@@ -3,6 +3,7 @@
 #include <vector>
 #include <array>
 #include <cstring>
+#include <algorithm>
 #include <pvac/pvac.hpp>
 #include <pvac/core/ct_safe.hpp>
 
@@ -81,17 +82,139 @@ static bool test_prf_R_domains() {
     return hw > 40 && hw < 88;
 }
 
+static bool test_prf_R_batch() {
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    // 11 seeds: one full lane group plus a partial one
+    std::vector<RSeed> seeds(11);
+    for (auto& s : seeds) {
+        s.ztag = csprng_u64();
+        s.nonce = make_nonce128();
+    }
+
+    auto R = prf_R_batch(pk, sk, seeds);
+    auto N = prf_R_noise_batch(pk, sk, seeds);
+    auto C = prf_R_core_batch(pk, sk, seeds, Dom::PRF_R2);
+
+    for (size_t i = 0; i < seeds.size(); i++) {
+        if (!ct::fp_eq(R[i], prf_R(pk, sk, seeds[i]))) return false;
+        if (!ct::fp_eq(N[i], prf_R_noise(pk, sk, seeds[i]))) return false;
+        if (!ct::fp_eq(C[i], prf_R_core(pk, sk, seeds[i], Dom::PRF_R2))) return false;
+    }
+
+    return prf_R_batch(pk, sk, {}).empty();
+}
+
+static bool test_toep_trunc() {
+#if defined(__PCLMUL__)
+    // full width, plus operands shorter than the two words the kernel reads
+    for (size_t wy : {0, 1, 2, 256}) {
+        for (size_t wt : {0, 1, 2, 258}) {
+            if (wy + wt < 2) continue;
+            std::vector<uint64_t> y(wy), top(wt);
+            for (auto& q : y) q = csprng_u64();
+            for (auto& q : top) q = csprng_u64();
+
+            uint64_t lo0 = 0, hi0 = 0, lo1 = 1, hi1 = 1, lo2 = 2, hi2 = 2;
+            toep_127_scalar(top, y, lo0, hi0);
+            toep_127_clmul(top, y, lo1, hi1);
+            toep_127_clmul_trunc(top, y, lo2, hi2);
+            if (lo0 != lo1 || hi0 != hi1) return false;
+            if (lo1 != lo2 || hi1 != hi2) return false;
+        }
+    }
+#endif
+    return true;
+}
+
+static bool test_prg_choose_k() {
+    // shake256("") = 46b9dd2b0ba88d13...
+    Shake256 e;
+    e.init();
+    e.pad();
+    if (e.next_u64() != 0x138da80b2bddb946ull) return false;
+
+    // legacy stream is pinned
+    const int ref1[8] = { 9112, 12412, 641, 7276, 10874, 4863, 3266, 11954 };
+    auto v1 = prg_choose_k(8, 16384, Dom::X_SEED, {1, 2, 3}, 1);
+    for (int i = 0; i < 8; i++) {
+        if (v1[i] != ref1[i]) return false;
+    }
+
+    // v2 draws are the plain shake256 output, read as le u32
+    std::vector<uint64_t> w = {7, 8, 9};
+    std::string msg = std::string(Dom::PRG_V2) + Dom::NOISE;
+    Shake256 sh;
+    sh.init();
+    sh.absorb((const uint8_t*)msg.data(), msg.size());
+    for (uint64_t x : w) {
+        uint8_t b[8];
+        store_le64(b, x);
+        sh.absorb(b, 8);
+    }
+    std::vector<int> ref2;
+    std::vector<char> seen(8192, 0);
+    while (ref2.size() < 128) {
+        uint8_t b[4];
+        sh.squeeze(b, 4);
+        int v = (int)(((uint32_t)b[0] | (uint32_t)b[1] << 8 |
+                       (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24) >> 19);
+        if (!seen[v]) { seen[v] = 1; ref2.push_back(v); }
+    }
+    if (prg_choose_k(128, 8192, Dom::NOISE, w) != ref2) return false;
+
+    // 4-way batch matches lone calls, odd N exercises rejection
+    std::vector<std::vector<uint64_t>> ws;
+    std::vector<PrgReq> rq;
+    for (int i = 0; i < 7; i++) ws.push_back({(uint64_t)i, 42});
+    for (int i = 0; i < 7; i++) {
+        int N = (i & 1) ? 16384 : 1000 + 37 * i;
+        rq.push_back({ 50 + 30 * i, N, Dom::H_GEN, ws[i].data(), ws[i].size() });
+    }
+    std::vector<std::vector<int>> outs(rq.size());
+    prg_choose_k_batch(rq.data(), rq.size(), outs.data());
+
+    for (size_t i = 0; i < rq.size(); i++) {
+        auto one = prg_choose_k(rq[i].k, rq[i].N, rq[i].label, ws[i]);
+        if (one != outs[i] || (int)one.size() != rq[i].k) return false;
+
+        std::vector<char> u(rq[i].N, 0);
+        for (int x : one) {
+            if (x < 0 || x >= rq[i].N || u[x]) return false;
+            u[x] = 1;
+        }
+    }
+
+    // k == N must terminate with a full permutation
+    auto all = prg_choose_k(300, 300, Dom::H_GEN, {5});
+    std::sort(all.begin(), all.end());
+    for (int i = 0; i < 300; i++) {
+        if (all[i] != i) return false;
+    }
+
+    return true;
+}
+
 int main() {
     bool ok1 = test_sha256_abc();
     bool ok2 = test_xof_basic();
     bool ok3 = test_prf_R_domains();
+    bool ok4 = test_prf_R_batch();
+    bool ok5 = test_toep_trunc();
+    bool ok6 = test_prg_choose_k();
 
     std::cout << "- prf/hash tests -\n";
     std::cout << "sha256(abc): " << (ok1 ? "ok" : "FAIL") << "\n";
     std::cout << "xof: " << (ok2 ? "ok" : "FAIL") << "\n";
     std::cout << "prf_R domains: " << (ok3 ? "ok" : "FAIL") << "\n";
+    std::cout << "prf_R batch: " << (ok4 ? "ok" : "FAIL") << "\n";
+    std::cout << "toeplitz trunc: " << (ok5 ? "ok" : "FAIL") << "\n";
+    std::cout << "prg_choose_k: " << (ok6 ? "ok" : "FAIL") << "\n";
 
-    bool all = ok1 && ok2 && ok3;
+    bool all = ok1 && ok2 && ok3 && ok4 && ok5 && ok6;
     std::cout << "\nresult: " << (all ? "PASS" : "FAIL") << "\n";
 
     return all ? 0 : 1;
@@ -0,0 +1,158 @@
+#include <pvac/pvac.hpp>
+
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+static RSeed random_seed() {
+    RSeed s;
+    s.ztag = csprng_u64();
+    s.nonce.lo = csprng_u64();
+    s.nonce.hi = csprng_u64();
+    return s;
+}
+
+int main() {
+    std::cout << "- prf cache test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    {
+        PrfCache memo;
+        RSeed s = random_seed();
+
+        Fp a = prf_R(pk, sk, s, &memo);
+        Fp b = prf_R(pk, sk, s, &memo);
+        Fp n = prf_R_noise(pk, sk, s, &memo);
+
+        assert(ct::fp_eq(a, prf_R(pk, sk, s)));
+        assert(ct::fp_eq(a, b));
+        assert(ct::fp_eq(n, prf_R_noise(pk, sk, s)));
+        assert(!ct::fp_eq(a, n));
+
+        auto st = memo.stats();
+        assert(st.hits == 1 && st.misses == 2 && st.entries == 2);
+
+        Fp d0 = prf_noise_delta(pk, sk, s, 3, 1, &memo);
+        assert(ct::fp_eq(d0, prf_noise_delta(pk, sk, s, 3, 1)));
+        assert(ct::fp_eq(d0, prf_noise_delta(pk, sk, s, 3, 1, &memo)));
+        assert(memo.stats().hits == 2);
+        std::cout << "hit/miss: ok\n";
+    }
+
+    {
+        // sum of shared inputs: the second read is all hits
+        PrfCache memo;
+        Cipher x = enc_value(pk, sk, 5);
+        Cipher y = enc_value(pk, sk, 7);
+        Cipher z = ct_add(pk, ct_add(pk, x, y), x);
+
+        Fp want = dec_value(pk, sk, z);
+        assert(ct::fp_eq(dec_value(pk, sk, z, &memo), want));
+        auto s1 = memo.stats();
+        assert(ct::fp_eq(dec_value(pk, sk, z, &memo), want));
+        auto s2 = memo.stats();
+
+        assert(s2.misses == s1.misses);
+        assert(s2.hits > s1.hits);
+        assert(want.lo == 17 && want.hi == 0);
+        std::cout << "dec_value shared layers: ok\n";
+    }
+
+    {
+        // batch decrypt: seeds repeated across ciphers are evaluated once
+        PrfCache memo;
+        std::vector<Cipher> cs;
+        cs.push_back(enc_value(pk, sk, 5));
+        cs.push_back(enc_value(pk, sk, 7));
+        cs.push_back(ct_add(pk, ct_add(pk, cs[0], cs[1]), cs[0]));
+        cs.push_back(ct_mul(pk, cs[0], cs[1]));
+
+        size_t base = 0;
+        for (int i = 0; i < 2; i++) {
+            for (const auto& L : cs[i].L) base += (L.rule == RRule::BASE);
+        }
+
+        std::vector<Fp> got = dec_values(pk, sk, cs, &memo);
+        assert(got.size() == cs.size());
+        for (size_t i = 0; i < cs.size(); i++) {
+            assert(ct::fp_eq(got[i], dec_value(pk, sk, cs[i])));
+        }
+        assert(got[2].lo == 17 && got[3].lo == 35);
+
+        auto st = memo.stats();
+        assert(st.hits == 0 && st.misses == base);
+        assert(dec_values(pk, sk, std::vector<Cipher>{}).empty());
+        std::cout << "dec_values dedup: ok\n";
+    }
+
+    {
+        // cap bounds the entry count, clock evicts the untouched ones
+        PrfCache memo(8 * PrfCache::ENTRY_BYTES);
+        assert(memo.capacity() == 8);
+
+        std::vector<RSeed> seeds;
+        for (int i = 0; i < 20; i++) seeds.push_back(random_seed());
+
+        std::vector<Fp> ref = prf_R_batch(pk, sk, seeds);
+        std::vector<Fp> got = prf_R_batch(pk, sk, seeds, &memo);
+        for (size_t i = 0; i < seeds.size(); i++) assert(ct::fp_eq(ref[i], got[i]));
+
+        auto st = memo.stats();
+        assert(st.entries == 8);
+        assert(st.evictions == 12);
+        assert(st.bytes <= 8 * PrfCache::ENTRY_BYTES);
+
+        Fp hot;
+        assert(memo.get(PrfCache::key_of(pk, seeds[19], PrfKind::R), hot));
+        assert(ct::fp_eq(hot, ref[19]));
+        assert(!memo.get(PrfCache::key_of(pk, seeds[0], PrfKind::R), hot));
+        std::cout << "memory cap: ok\n";
+    }
+
+    {
+        // many threads over a small shared key set and a tight cap
+        PrfCache memo(4 * PrfCache::ENTRY_BYTES);
+
+        std::vector<RSeed> seeds;
+        for (int i = 0; i < 6; i++) seeds.push_back(random_seed());
+        std::vector<Fp> ref = prf_R_batch(pk, sk, seeds);
+
+        const int T = 4;
+        const int N = 2000;
+        std::vector<int> bad(T, 0);
+        std::vector<std::thread> th;
+
+        for (int t = 0; t < T; t++) {
+            th.emplace_back([&, t] {
+                for (int i = 0; i < N; i++) {
+                    size_t j = (size_t)(i * 7 + t) % seeds.size();
+                    PrfCacheKey k = PrfCache::key_of(pk, seeds[j], PrfKind::R);
+                    Fp v;
+                    if (memo.get(k, v)) {
+                        bad[t] += !ct::fp_eq(v, ref[j]);
+                    } else {
+                        memo.put(k, ref[j]);
+                    }
+                }
+            });
+        }
+        for (auto& x : th) x.join();
+
+        for (int t = 0; t < T; t++) assert(bad[t] == 0);
+        auto st = memo.stats();
+        assert(st.hits + st.misses == (uint64_t)T * N);
+        assert(st.entries <= 4);
+        std::cout << "threads: ok\n";
+    }
+
+    std::cout << "PASS\n";
+    return 0;
+}
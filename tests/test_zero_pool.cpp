@@ -0,0 +1,128 @@
+#include <pvac/pvac.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <cassert>
+
+using namespace pvac;
+
+static bool fp_eq(const Fp & a, const Fp & b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+static double ms_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main() {
+    std::cout << "- zero pool test -\n";
+
+    {
+        // every pushed value comes out exactly once across 4 x 4 threads
+        MpmcRing<uint64_t> r(100);
+        assert(r.capacity() == 128);
+
+        const uint64_t per = 20000;
+        std::atomic<uint64_t> sum { 0 }, cnt { 0 };
+        std::vector<std::thread> th;
+
+        for (uint64_t p = 0; p < 4; p++) {
+            th.emplace_back([&, p] {
+                for (uint64_t i = 0; i < per; i++) {
+                    uint64_t v = p * per + i + 1;
+                    while (!r.push(std::move(v))) std::this_thread::yield();
+                }
+            });
+            th.emplace_back([&] {
+                uint64_t v;
+                while (cnt.load() < 4 * per) {
+                    if (r.pop(v)) { sum += v; cnt++; }
+                    else std::this_thread::yield();
+                }
+            });
+        }
+
+        for (auto & t : th) t.join();
+
+        const uint64_t n = 4 * per;
+        assert(cnt == n && sum == n * (n + 1) / 2 && r.size() == 0);
+        std::cout << "mpmc ring: ok\n";
+    }
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    ZeroPool zp(pk, sk, 2, 16, 4);
+    assert(zp.zero.wait_depth(16, 120000) && zp.one.wait_depth(4, 120000));
+
+    PoolStats st = zp.zero.stats();
+    assert(st.depth == 16 && st.high == 16 && st.low == 4 && st.made >= 16);
+    std::cout << "warm: depth " << st.depth << ", refill " << st.refill_per_s << " ct/s per worker\n";
+
+    {
+        // drawn ciphers decrypt right and are all distinct
+        std::set<std::array<uint8_t, 32>> seen;
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<Cipher> got;
+
+        for (int i = 0; i < 12; i++) got.push_back(zp.zero.take());
+        double take_ms = ms_since(t0);
+
+        for (auto & c : got) {
+            assert(fp_eq(dec_value(pk, sk, c), fp_from_u64(0)));
+            seen.insert(commit_ct(pk, c));
+        }
+        assert(seen.size() == got.size());
+
+        Cipher one = zp.one.take();
+        assert(fp_eq(dec_value(pk, sk, one), fp_from_u64(1)));
+
+        st = zp.zero.stats();
+        assert(st.taken == 12 && st.misses == 0);
+
+        t0 = std::chrono::steady_clock::now();
+        Cipher z = enc_zero_depth(pk, sk, 2);
+        double enc_ms = ms_since(t0);
+        std::cout << "take 12: " << take_ms << " ms, one enc_zero: " << enc_ms << " ms\n";
+    }
+
+    {
+        // below low the workers come back and refill to high
+        Cipher c;
+        while (zp.zero.try_take(c)) {}
+        assert(zp.zero.wait_depth(16, 120000));
+        std::cout << "refill after drain: ok\n";
+    }
+
+    {
+        // an empty pool still answers, inline
+        ZeroPool tiny(pk, sk, 1, 1, 1);
+        tiny.zero.stop();
+        Cipher c;
+        while (tiny.zero.try_take(c)) {}
+        Cipher z = tiny.zero.take();
+        assert(fp_eq(dec_value(pk, sk, z), fp_from_u64(0)));
+        assert(tiny.zero.stats().misses == 1);
+        std::cout << "miss falls back inline: ok\n";
+    }
+
+    {
+        Cipher x = ct_mul(pk, enc_value(pk, sk, 7), enc_value(pk, sk, 6));
+        Cipher r = ct_recrypt(pk, zp, x);
+        assert(fp_eq(dec_value(pk, sk, r), fp_from_u64(42)));
+
+        EvalKey ek = make_evalkey(zp, 8);
+        assert(ek.zero_pool.size() == 8);
+        assert(fp_eq(dec_value(pk, sk, ct_recrypt(pk, ek, x)), fp_from_u64(42)));
+        assert(fp_eq(dec_value(pk, sk, ek.enc_one), fp_from_u64(1)));
+        std::cout << "recrypt / evalkey from pool: ok\n";
+    }
+
+    std::cout << "\nresult: PASS\n";
+    return 0;
+}